@@ -487,6 +487,7 @@ Pokemon *encounter(Data *data, int manhattan_distance)
     }
 
     destroy_win(encounter_win);
+    delete pokemon;
 
     return 0;
 }
@@ -571,39 +572,28 @@ char move_pc(map *map, Data *data, pc *pc, int input, int manhattan_distance)
     return ret_val;
 }
 
-void move_dijkstra_trainer(heap_t *path_heap, path path_map[MAP_HEIGHT][MAP_WIDTH], map *map, npc *npc, Data *data)
+void move_dijkstra_trainer(path *path, map *map, npc *npc, Data *data)
 {
-    path *cheapest_path;
-    int battle_outcome;
+    int cell, next, n, i, battle_outcome;
 
-    cheapest_path = &path_map[npc->get_pos().y - 1][npc->get_pos().x - 1];
+    cell = npc->get_pos().y * MAP_WIDTH + npc->get_pos().x;
+    next = cell;
     battle_outcome = 0;
 
-    path::dijkstra_path(path_heap, map, path_map, npc->get_type());
+    path->dijkstra_path(map);
 
-    if (path_map[npc->get_pos().y - 1][npc->get_pos().x].get_cost() < cheapest_path->get_cost()) {
-        cheapest_path = &path_map[npc->get_pos().y - 1][npc->get_pos().x];
-    }
-    if (path_map[npc->get_pos().y - 1][npc->get_pos().x + 1].get_cost() < cheapest_path->get_cost()) {
-        cheapest_path = &path_map[npc->get_pos().y - 1][npc->get_pos().x + 1];
-    }
-    if (path_map[npc->get_pos().y][npc->get_pos().x - 1].get_cost() < cheapest_path->get_cost()) {
-        cheapest_path = &path_map[npc->get_pos().y][npc->get_pos().x - 1];
-    }
-    if (path_map[npc->get_pos().y][npc->get_pos().x + 1].get_cost() < cheapest_path->get_cost()) {
-        cheapest_path = &path_map[npc->get_pos().y][npc->get_pos().x + 1];
-    }
-    if (path_map[npc->get_pos().y + 1][npc->get_pos().x - 1].get_cost() < cheapest_path->get_cost()) {
-        cheapest_path = &path_map[npc->get_pos().y + 1][npc->get_pos().x - 1];
-    }
-    if (path_map[npc->get_pos().y + 1][npc->get_pos().x].get_cost() < cheapest_path->get_cost()) {
-        cheapest_path = &path_map[npc->get_pos().y + 1][npc->get_pos().x];
-    }
-    if (path_map[npc->get_pos().y + 1][npc->get_pos().x + 1].get_cost() < cheapest_path->get_cost()) {
-        cheapest_path = &path_map[npc->get_pos().y + 1][npc->get_pos().x + 1];
+    // The costs don't see other trainers, so take the cheapest neighbor no trainer is on
+    for (i = 0; i < 8; i++) {
+        n = cell + path::neighbor_offset[i];
+        if ((next == cell || path->get_cost(n) < path->get_cost(next)) &&
+            path->get_cost(n) != INT_MAX &&
+            (map->trainer_map[n / MAP_WIDTH][n % MAP_WIDTH] == nullptr ||
+             map->trainer_map[n / MAP_WIDTH][n % MAP_WIDTH]->get_type() == pc_e)) {
+            next = n;
+        }
     }
-    if (cheapest_path->get_cost() == 0) {
-        cheapest_path = &path_map[npc->get_pos().y    ][npc->get_pos().x    ];
+    if (next != cell && path->get_cost(next) == 0) {
+        next = cell;
 
         battle_outcome = battle((pc *)map->trainer_map[map->get_pc_pos().y][map->get_pc_pos().x], npc, data);
 
@@ -615,10 +605,11 @@ void move_dijkstra_trainer(heap_t *path_heap, path path_map[MAP_HEIGHT][MAP_WIDT
     }
 
     map->trainer_map[npc->get_pos().y][npc->get_pos().x] = nullptr;
-    npc->set_pos(cheapest_path->get_coordinate());
+    npc->set_pos_y(next / MAP_WIDTH);
+    npc->set_pos_x(next % MAP_WIDTH);
     map->trainer_map[npc->get_pos().y][npc->get_pos().x] = npc;
     if (npc->get_next_turn() > -1) {
-        npc->set_next_turn(npc->get_next_turn() + cheapest_path->get_terrain_cost());
+        npc->set_next_turn(npc->get_next_turn() + path->get_terrain_cost(next));
     }
 }
 
@@ -740,7 +731,7 @@ void move_wanderer_explorer(map *map, npc *npc, Data *data)
     }
 }
 
-void move_swimmer(heap_t *path_heap, path path_map[MAP_HEIGHT][MAP_WIDTH], map *map, npc *m, coordinate_t pc_pos, Data *data)
+void move_swimmer(path *path, map *map, npc *m, coordinate_t pc_pos, Data *data)
 {
     int battle_outcome;
 
@@ -753,7 +744,7 @@ void move_swimmer(heap_t *path_heap, path path_map[MAP_HEIGHT][MAP_WIDTH], map *
          map->terrain_map[pc_pos.y + 1][pc_pos.x    ] == bridge) ||
         (map->terrain_map[pc_pos.y    ][pc_pos.x - 1] == water ||
          map->terrain_map[pc_pos.y    ][pc_pos.x - 1] == bridge)) {
-        move_dijkstra_trainer(path_heap, path_map, map, m, data);
+        move_dijkstra_trainer(path, map, m, data);
         // move similar to wanderer_e
     } else {
         // just starting or already going up and need to continue
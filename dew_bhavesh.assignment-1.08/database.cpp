@@ -1,6 +1,7 @@
 #include <climits>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include "database.h"
 
 std::ifstream *get_file(std::string filename)
@@ -72,7 +73,9 @@ int Data::get_pokemon_data(Data &data)
                         order,
                         is_default);
         data.pokemon_data.push_back(*pd);
+        delete pd;
     }
+    delete pokemon_file;
     got_data = 1;
 
     return got_data;
@@ -101,7 +104,9 @@ int Data::get_pokemon_types(Data &data)
 
         pt = new PokemonType(pokemon_id, type_id, slot);
         data.pokemon_types.push_back(*pt);
+        delete pt;
     }
+    delete pokemon_types_file;
     got_data = 1;
 
     return got_data;
@@ -129,8 +134,10 @@ int Data::get_type_names(Data &data)
         if (local_language_id == 9) {
             tn = new TypeName(type_id, local_language_id, name);
             data.type_names.push_back(*tn);
+            delete tn;
         }
     }
+    delete type_names_file;
     got_data = 1;
 
     return got_data;
@@ -228,7 +235,9 @@ int Data::get_pokemon_species(Data &data)
                                 order,
                                 conquest_order);
         data.pokemon_species.push_back(*ps);
+        delete ps;
     }
+    delete pokemon_species_file;
     got_data = 1;
 
     return got_data;
@@ -260,7 +269,9 @@ int Data::get_pokemon_stats(Data &data)
 
         ps = new PokemonStat(pokemon_id, stat_id, base_stat, effort);
         data.pokemon_stats.push_back(*ps);
+        delete ps;
     }
+    delete pokemon_stats_file;
     got_data = 1;
 
     return got_data;
@@ -294,7 +305,9 @@ int Data::get_stats(Data &data)
 
         s = new Stat(id, damage_class_id, identifier, is_battle_only, game_index);
         data.stats.push_back(*s);
+        delete s;
     }
+    delete stats_file;
     got_data = 1;
 
     return got_data;
@@ -337,7 +350,9 @@ int Data::get_pokemon_moves(Data &data)
                              level,
                              order);
         data.pokemon_moves.push_back(*pm);
+        delete pm;
     }
+    delete pokemon_moves_file;
     got_data = 1;
 
     return got_data;
@@ -415,7 +430,9 @@ int Data::get_moves(Data &data)
                      contest_effect_id,
                      super_contest_effect_id);
         data.moves.push_back(*m);
+        delete m;
     }
+    delete moves_file;
     got_data = 1;
 
     return got_data;
@@ -446,12 +463,78 @@ int Data::get_experience(Data &data)
                            level, 
                            experience);
         data.experience.push_back(*e);
+        delete e;
     }
+    delete experience_file;
     got_data = 1;
 
     return got_data;
 }
 
+static bool learnable_level_cmp(const LearnableMove &a, const LearnableMove &b)
+{
+    return (a.level == b.level) ? a.move_id < b.move_id : a.level < b.level;
+}
+
+static bool learnable_move_cmp(const LearnableMove &a, const LearnableMove &b)
+{
+    return (a.move_id == b.move_id) ? a.level < b.level : a.move_id < b.move_id;
+}
+
+static bool learnable_same_move(const LearnableMove &a, const LearnableMove &b)
+{
+    return a.move_id == b.move_id;
+}
+
+/*
+    Groups the level-up moves (pokemon_move_method_id 1) by pokemon, keeping each move once at the lowest
+    level it can be learned, and sorts every learnset by level.  The moves learnable at or below a level
+    are then always a prefix of the learnset.
+*/
+void Data::build_learnsets()
+{
+    size_t i;
+    int max_id = 0;
+
+    for (i = 0; i < pokemon_moves.size(); i++) {
+        if (pokemon_moves[i].pokemon_move_method_id == 1 && pokemon_moves[i].pokemon_id != INT_MAX) {
+            max_id = std::max(max_id, pokemon_moves[i].pokemon_id);
+        }
+    }
+    learnsets.assign(max_id + 1, std::vector<LearnableMove>());
+
+    for (i = 0; i < pokemon_moves.size(); i++) {
+        if (pokemon_moves[i].pokemon_move_method_id == 1 && pokemon_moves[i].pokemon_id != INT_MAX) {
+            learnsets[pokemon_moves[i].pokemon_id].push_back(LearnableMove(pokemon_moves[i].move_id,
+                                                                           pokemon_moves[i].level));
+        }
+    }
+
+    for (i = 0; i < learnsets.size(); i++) {
+        std::vector<LearnableMove> &learnset = learnsets[i];
+
+        // unique keeps the first of each run, which is the move's lowest level
+        std::sort(learnset.begin(), learnset.end(), learnable_move_cmp);
+        learnset.erase(std::unique(learnset.begin(), learnset.end(), learnable_same_move), learnset.end());
+        std::sort(learnset.begin(), learnset.end(), learnable_level_cmp);
+    }
+}
+
+/*
+    Number of distinct moves pokemon_id can have learned by level; these are the first entries of its learnset.
+*/
+size_t Data::count_learnable(int pokemon_id, int level)
+{
+    if (pokemon_id < 0 || (size_t) pokemon_id >= learnsets.size()) {
+        return 0;
+    }
+
+    std::vector<LearnableMove> &learnset = learnsets[pokemon_id];
+    return std::upper_bound(learnset.begin(), learnset.end(), LearnableMove(INT_MAX, level),
+                            [](const LearnableMove &a, const LearnableMove &b) { return a.level < b.level; })
+           - learnset.begin();
+}
+
 int Data::get_data(Data &data)
 {
     int got_data;
@@ -483,6 +566,7 @@ int Data::get_data(Data &data)
     if (!got_data) {
         std::cerr << "Error: Could not get pokemon moves data." << std::endl;
     }
+    data.build_learnsets();
     got_data = get_moves(data);
     if (!got_data) {
         std::cerr << "Error: Could not get moves data." << std::endl;
@@ -193,6 +193,20 @@ public:
     }
 };
 
+/* One entry of a species' level-up learnset.  Learnsets are sorted by *
+ * level and hold each move once, at the lowest level it is learned.    */
+class LearnableMove {
+public:
+    int move_id;
+    int level;
+    LearnableMove(int move_id,
+                  int level)
+    {
+        this->move_id = move_id;
+        this->level = level;
+    }
+};
+
 class Move {
 public:
     int id;
@@ -270,6 +284,7 @@ public:
     std::vector<PokemonMove> pokemon_moves;
     std::vector<Move> moves;
     std::vector<Experience> experience;
+    std::vector<std::vector<LearnableMove> > learnsets; // indexed by pokemon_id
     int get_data(Data &data);
     int get_pokemon_data(Data &data);
     int get_pokemon_types(Data &data);
@@ -280,6 +295,8 @@ public:
     int get_pokemon_moves(Data &data);
     int get_moves(Data &data);
     int get_experience(Data &data);
+    void build_learnsets();
+    size_t count_learnable(int pokemon_id, int level);
     ~Data() 
     {
         pokemon_data.clear();
@@ -291,6 +308,7 @@ public:
         pokemon_moves.clear();
         moves.clear();
         experience.clear();
+        learnsets.clear();
     };
 };
 
@@ -515,7 +515,7 @@ void place_npc(heap_t *turn_heap, map *map, Data *data, trainer_type_e type, int
         valid_character_position = check_trainer_position(map, start, type);
     }
 
-    map->trainer_map[start.y][start.x] = new npc(data, type, manhattan_distance);
+    map->trainer_map[start.y][start.x] = map->get_npc_pool()->create(data, type, manhattan_distance, map->get_pokemon_pool());
     map->trainer_map[start.y][start.x]->set_pos(start);
     heap_insert(turn_heap, map->trainer_map[start.y][start.x]);
 }
@@ -26,6 +26,11 @@ class map {
         coordinate_t pc_pos;
         heap_t *turn_heap;
         int pc_turn;
+
+        // Every npc on the map and every Pokemon in their parties lives in these pools, so
+        // tearing the map down is just releasing them. The pc is not owned by any map.
+        object_pool<npc> npc_pool;
+        object_pool<Pokemon> pokemon_pool;
     public:
         terrain_e terrain_map[MAP_HEIGHT][MAP_WIDTH];
         trainer *trainer_map[MAP_HEIGHT][MAP_WIDTH];
@@ -52,18 +57,13 @@ class map {
         }
         ~map()
         {
-            int x, y;
-
-            heap_delete(turn_heap);
-            free(turn_heap);
-
-            for (y = 0; y < MAP_HEIGHT; y++) {
-                for (x = 0; x < MAP_WIDTH; x++) {
-                    if (trainer_map[y][x] != nullptr) {
-                        free(trainer_map[y][x]);
-                    }
-                }
+            if (turn_heap) {
+                heap_delete(turn_heap);
+                free(turn_heap);
             }
+
+            npc_pool.reset();
+            pokemon_pool.reset();
         }
         int get_n() const { return n; }
         void set_n(int north) { n = north; }
@@ -79,6 +79,8 @@ class map {
         void set_turn_heap(heap_t *heap) { turn_heap = heap; }
         int get_pc_turn() const { return pc_turn; }
         void set_pc_turn(int turn) { pc_turn = turn; }
+        object_pool<npc> *get_npc_pool() { return &npc_pool; }
+        object_pool<Pokemon> *get_pokemon_pool() { return &pokemon_pool; }
 };
 
 void generate_map(map *map, int n, int s, int w, int e, int manhattan_distance);
@@ -48,121 +48,83 @@ int path::calculate_terrain_cost(terrain_e terrain_type, trainer_type_e trainer_
     return terrain_cost;
 }
 
+const int path::neighbor_offset[8] = {
+    -MAP_WIDTH - 1, -MAP_WIDTH, -MAP_WIDTH + 1,
+    -1,                          1,
+    MAP_WIDTH - 1,  MAP_WIDTH,  MAP_WIDTH + 1,
+};
+
+static int32_t cost_cmp(const void *key, const void *with)
+{
+    return *(const int *) key - *(const int *) with;
+}
+
+path::path(trainer_type_e type)
+{
+    int c;
+
+    trainer_type = type;
+    for_map = nullptr;
+    for_cell = -1;
+    heap_init(&heap, cost_cmp, nullptr);
+
+    for (c = 0; c < MAP_CELLS; c++) {
+        heap_node[c] = nullptr;
+        terrain_cost[c] = INT_MAX;
+        cost[c] = INT_MAX;
+    }
+}
+
 /*
- * Fills in the Dijkstra's cost map for the trainer.
- * In the future, can return just the path for the trainer to the PC.
+ * Fills in the Dijkstra's cost map to the pc, unless it is already for the pc's cell.
+ * Cells join the heap as they are reached, so only the ones the trainer can get to pass through it.
+ * Other trainers don't block a cell here, since they move between the pc's turns;
+ * move_dijkstra_trainer() steps around them.
  */
-void path::dijkstra_path(heap_t *heap, map *map, path path_map[MAP_HEIGHT][MAP_WIDTH], trainer_type_e trainer_type)
+void path::dijkstra_path(map *map)
 {
-    if (trainer_type != hiker_e && trainer_type != rival_e && trainer_type != swimmer_e) {
+    int pc_cell, c, n, i, x, y;
+    int *p;
+
+    pc_cell = map->get_pc_pos().y * MAP_WIDTH + map->get_pc_pos().x;
+    if (map == for_map && pc_cell == for_cell) {
         return;
     }
 
-    coordinate_t coord;
-    int x, y;
-    path *p;
-
-    // get all coordinates
-    for (y = 0; y < MAP_HEIGHT; y++) {
-        for (x = 0; x < MAP_WIDTH; x++) {
-            coord.y = y;
-            coord.x = x;
-            path_map[y][x].set_coordinate(coord);
+    if (map != for_map) { // terrain costs only change with the map
+        for (y = 0; y < MAP_HEIGHT; y++) {
+            for (x = 0; x < MAP_WIDTH; x++) {
+                terrain_cost[y * MAP_WIDTH + x] = path::calculate_terrain_cost(map->terrain_map[y][x], trainer_type);
+            }
         }
     }
 
-    for (y = 0; y < MAP_HEIGHT; y++) { // assign every path_map to infinity
-        for (x = 0; x < MAP_WIDTH; x++) {
-            path_map[y][x].set_cost(INT_MAX);
-        }
+    for (c = 0; c < MAP_CELLS; c++) {
+        cost[c] = INT_MAX;
     }
 
-    int move_cost;
-    for (y = 0; y < MAP_HEIGHT; y++) { // add every traversable path_map to the heap as a node
-        for (x = 0; x < MAP_WIDTH; x++) {
-            path_map[y][x].set_terrain(map->terrain_map[y][x]);
+    cost[pc_cell] = 0;
+    heap_node[pc_cell] = heap_insert(&heap, &cost[pc_cell]);
 
-            move_cost = path::calculate_terrain_cost(path_map[y][x].get_terrain(), trainer_type);
+    while ((p = (int *) heap_remove_min(&heap))) { // visit each cell and recalculate the costs of cells around it
+        c = p - cost;
+        heap_node[c] = nullptr;
 
-            if (map->trainer_map[y][x] != nullptr) {
-                if (map->trainer_map[y][x]->get_type() != pc_e) {
-                    move_cost = INT_MAX;
-                } else {
-                    move_cost = 0;
-                }
+        for (i = 0; i < 8; i++) {
+            n = c + neighbor_offset[i];
+            if (terrain_cost[n] == INT_MAX || cost[n] <= cost[c] + terrain_cost[n]) {
+                continue;
             }
 
-            if (move_cost != INT_MAX) {
-                if (move_cost == 0) {
-                    path_map[y][x].set_cost(move_cost); // So the pc node is pulled out first to get cost map.
-                }
-                path_map[y][x].set_heap_node(heap_insert(heap, &path_map[y][x]));
+            cost[n] = cost[c] + terrain_cost[n];
+            if (heap_node[n]) {
+                heap_decrease_key_no_replace(&heap, heap_node[n]);
             } else {
-                path_map[y][x].set_heap_node(nullptr);
+                heap_node[n] = heap_insert(&heap, &cost[n]);
             }
-
-            path_map[y][x].set_terrain_cost(move_cost);
         }
     }
 
-    while ((p = (path *) heap_remove_min(heap))) { // visit each node and recalculate the distances of nodes around it
-        p->set_heap_node(nullptr);
-
-        if ((path_map[p->get_coordinate().y - 1][p->get_coordinate().x - 1].get_heap_node()) &&
-            (path_map[p->get_coordinate().y - 1][p->get_coordinate().x - 1].get_cost() >
-             (p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x - 1].get_terrain_cost()) &&
-              p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x - 1].get_terrain_cost() > 0)) {
-            path_map[p->get_coordinate().y - 1][p->get_coordinate().x - 1].set_cost(p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x - 1].get_terrain_cost());
-            heap_decrease_key_no_replace(heap, path_map[p->get_coordinate().y - 1][p->get_coordinate().x - 1].get_heap_node());
-        }
-        if ((path_map[p->get_coordinate().y - 1][p->get_coordinate().x    ].get_heap_node()) &&
-            (path_map[p->get_coordinate().y - 1][p->get_coordinate().x    ].get_cost() >
-             (p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x].get_terrain_cost()) &&
-              p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x].get_terrain_cost() > 0)) {
-            path_map[p->get_coordinate().y - 1][p->get_coordinate().x    ].set_cost(p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x    ].get_terrain_cost());
-            heap_decrease_key_no_replace(heap, path_map[p->get_coordinate().y - 1][p->get_coordinate().x    ].get_heap_node());
-        }
-        if ((path_map[p->get_coordinate().y - 1][p->get_coordinate().x + 1].get_heap_node()) &&
-            (path_map[p->get_coordinate().y - 1][p->get_coordinate().x + 1].get_cost() >
-             (p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x + 1].get_terrain_cost()) &&
-              p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x + 1].get_terrain_cost() > 0)) {
-            path_map[p->get_coordinate().y - 1][p->get_coordinate().x + 1].set_cost(p->get_cost() + path_map[p->get_coordinate().y - 1][p->get_coordinate().x + 1].get_terrain_cost());
-            heap_decrease_key_no_replace(heap, path_map[p->get_coordinate().y - 1][p->get_coordinate().x + 1].get_heap_node());
-        }
-        if ((path_map[p->get_coordinate().y    ][p->get_coordinate().x - 1].get_heap_node()) &&
-            (path_map[p->get_coordinate().y    ][p->get_coordinate().x - 1].get_cost() >
-             (p->get_cost() + path_map[p->get_coordinate().y    ][p->get_coordinate().x - 1].get_terrain_cost()) &&
-              p->get_cost() + path_map[p->get_coordinate().y    ][p->get_coordinate().x - 1].get_terrain_cost() > 0)) {
-            path_map[p->get_coordinate().y    ][p->get_coordinate().x - 1].set_cost(p->get_cost()+ path_map[p->get_coordinate().y    ][p->get_coordinate().x - 1].get_terrain_cost());
-            heap_decrease_key_no_replace(heap, path_map[p->get_coordinate().y    ][p->get_coordinate().x - 1].get_heap_node());
-        }
-        if ((path_map[p->get_coordinate().y    ][p->get_coordinate().x + 1].get_heap_node()) &&
-            (path_map[p->get_coordinate().y    ][p->get_coordinate().x + 1].get_cost() >
-             (p->get_cost()+ path_map[p->get_coordinate().y    ][p->get_coordinate().x + 1].get_terrain_cost()) &&
-              p->get_cost()+ path_map[p->get_coordinate().y    ][p->get_coordinate().x + 1].get_terrain_cost() > 0)) {
-            path_map[p->get_coordinate().y    ][p->get_coordinate().x + 1].set_cost(p->get_cost()+ path_map[p->get_coordinate().y    ][p->get_coordinate().x + 1].get_terrain_cost());
-            heap_decrease_key_no_replace(heap, path_map[p->get_coordinate().y    ][p->get_coordinate().x + 1].get_heap_node());
-        }
-        if ((path_map[p->get_coordinate().y + 1][p->get_coordinate().x - 1].get_heap_node()) &&
-            (path_map[p->get_coordinate().y + 1][p->get_coordinate().x - 1].get_cost() >
-             (p->get_cost() + path_map[p->get_coordinate().y + 1][p->get_coordinate().x - 1].get_terrain_cost()) &&
-              p->get_cost() + path_map[p->get_coordinate().y + 1][p->get_coordinate().x - 1].get_terrain_cost() > 0)) {
-            path_map[p->get_coordinate().y + 1][p->get_coordinate().x - 1].set_cost(p->get_cost()+ path_map[p->get_coordinate().y + 1][p->get_coordinate().x - 1].get_terrain_cost());
-            heap_decrease_key_no_replace(heap, path_map[p->get_coordinate().y + 1][p->get_coordinate().x - 1].get_heap_node());
-        }
-        if ((path_map[p->get_coordinate().y + 1][p->get_coordinate().x    ].get_heap_node()) &&
-            (path_map[p->get_coordinate().y + 1][p->get_coordinate().x    ].get_cost() >
-             (p->get_cost()+ path_map[p->get_coordinate().y + 1][p->get_coordinate().x    ].get_terrain_cost()) &&
-              p->get_cost()+ path_map[p->get_coordinate().y + 1][p->get_coordinate().x    ].get_terrain_cost() > 0)) {
-            path_map[p->get_coordinate().y + 1][p->get_coordinate().x    ].set_cost(p->get_cost()+ path_map[p->get_coordinate().y + 1][p->get_coordinate().x    ].get_terrain_cost());
-            heap_decrease_key_no_replace(heap, path_map[p->get_coordinate().y + 1][p->get_coordinate().x    ].get_heap_node());
-        }
-        if ((path_map[p->get_coordinate().y + 1][p->get_coordinate().x + 1].get_heap_node()) &&
-            (path_map[p->get_coordinate().y + 1][p->get_coordinate().x + 1].get_cost() >
-             (p->get_cost()+ path_map[p->get_coordinate().y + 1][p->get_coordinate().x + 1].get_terrain_cost()) &&
-              p->get_cost()+ path_map[p->get_coordinate().y + 1][p->get_coordinate().x + 1].get_terrain_cost() > 0)) {
-            path_map[p->get_coordinate().y + 1][p->get_coordinate().x + 1].set_cost(p->get_cost()+ path_map[p->get_coordinate().y + 1][p->get_coordinate().x + 1].get_terrain_cost());
-            heap_decrease_key_no_replace(heap, path_map[p->get_coordinate().y + 1][p->get_coordinate().x + 1].get_heap_node());
-        }
-    }
+    for_map = map;
+    for_cell = pc_cell;
 }
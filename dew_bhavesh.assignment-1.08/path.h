@@ -4,38 +4,33 @@
 #include <climits>
 #include "map.h"
 
+#define MAP_CELLS (MAP_HEIGHT * MAP_WIDTH)
+
+// Dijkstra's cost map to the pc for one trainer type. Cells are flat, at y * MAP_WIDTH + x,
+// so a neighbor is a fixed offset away. Terrain never changes, so the costs only need
+// finding again once the pc has moved, however many trainers move by them in between.
 class path {
     private:
-        heap_node_t *heap_node; // The pointer node in heap/priority queue
-        coordinate_t coordinate;
-        terrain_e terrain;
-        int terrain_cost;
-        int cost; // Dijkstra's path cost at node
+        trainer_type_e trainer_type;
+        map *for_map; // The map and pc cell the costs were last found for; maps live as long as the world
+        int for_cell;
+        heap_t heap;
+        heap_node_t *heap_node[MAP_CELLS]; // The cell's node while it's in the heap
+        int terrain_cost[MAP_CELLS]; // Cost to move onto the cell, INT_MAX if the trainer can't
+        int cost[MAP_CELLS]; // Dijkstra's path cost from the cell to the pc
     public:
-        path() : coordinate()
-        {
-            heap_node = nullptr;
-            coordinate.y = 0;
-            coordinate.x = 0;
-            terrain = edge;
-            terrain_cost = INT_MAX;
-            cost = INT_MAX;
-        }
-        ~path() {};
-        
+        static const int neighbor_offset[8];
+
+        explicit path(trainer_type_e type);
+        ~path() { heap_delete(&heap); }
+        path(const path &) = delete;
+        path &operator=(const path &) = delete;
+
         static int calculate_terrain_cost(terrain_e terrain_type, trainer_type_e trainer_type);
-        static void dijkstra_path(heap_t *heap, map *map, path path_map[MAP_HEIGHT][MAP_WIDTH], trainer_type_e trainer_type);
+        void dijkstra_path(map *map);
 
-        void set_heap_node(heap_node_t *node) { heap_node = node; }
-        heap_node_t *get_heap_node() { return heap_node; }
-        void set_coordinate(coordinate_t c) { coordinate = c; }
-        coordinate_t get_coordinate() { return coordinate; }
-        void set_terrain(terrain_e t) { terrain = t; }
-        terrain_e get_terrain() { return terrain; }
-        void set_terrain_cost(int t_c) { terrain_cost = t_c; }
-        int get_terrain_cost() const { return terrain_cost; }
-        void set_cost(int c) { cost = c; }
-        int get_cost() const { return cost; }
+        int get_terrain_cost(int cell) const { return terrain_cost[cell]; }
+        int get_cost(int cell) const { return cost[cell]; }
 };
 
 #endif
@@ -4,10 +4,6 @@
 
 #include "world.h"
 
-static int32_t path_cmp(const void *key, const void *with) { 
-    return ((path *) key)->get_cost() - ((path *) with)->get_cost();
-}
-
 chtype view[MAP_HEIGHT][MAP_WIDTH];
 
 void init_terminal(void)
@@ -169,12 +165,21 @@ Pokemon *pick_starter(Data *data)
 
     switch (choice) {
         case 'a':
+            delete second;
+            delete third;
             return first;
         case 'b':
+            delete first;
+            delete third;
             return second;
         case 'c':
+            delete first;
+            delete second;
             return third;
         default:
+            delete first;
+            delete second;
+            delete third;
             return nullptr;
     }
 }
@@ -342,23 +347,16 @@ int pc_turn(world *world, Data *data, pc *pc, int manhattan_distance)
     return quit_game;
 }
 
-void game_loop(heap_t *path_heap, world *world, Data *data)
+void game_loop(world *world, Data *data)
 {
     trainer *t;
     pc *p;
     npc *n;
     int manhattan_distance;
-    int x, y, quit_game;
-    path swimmer_path[MAP_HEIGHT][MAP_WIDTH];
+    int quit_game;
 
     quit_game = 0;
 
-    for (y = 0; y < MAP_HEIGHT; y++) {
-        for (x = 0; x < MAP_WIDTH; x++) {
-            swimmer_path[y][x] = *new path();
-        }
-    }
-
     render_view(world->get_current_map(), world->get_location());
 
     while (!quit_game) {
@@ -376,10 +374,10 @@ void game_loop(heap_t *path_heap, world *world, Data *data)
                 t = p;
                 break;
             case hiker_e:
-                move_dijkstra_trainer(path_heap, world->hiker_path, world->get_current_map(), n, data);
+                move_dijkstra_trainer(&world->hiker_path, world->get_current_map(), n, data);
                 break;
             case rival_e:
-                move_dijkstra_trainer(path_heap, world->rival_path, world->get_current_map(), n, data);
+                move_dijkstra_trainer(&world->rival_path, world->get_current_map(), n, data);
                 break;
             case pacer_e:
                 move_pacer(world->get_current_map(), n, data);
@@ -392,7 +390,7 @@ void game_loop(heap_t *path_heap, world *world, Data *data)
                 n->set_next_turn(n->get_next_turn() + 15);
                 break;
             case swimmer_e:
-                move_swimmer(path_heap, swimmer_path, world->get_current_map(), n, world->get_current_map()->get_pc_pos(), data);
+                move_swimmer(&world->swimmer_path, world->get_current_map(), n, world->get_current_map()->get_pc_pos(), data);
                 break;
         }
         if (t->get_type() != pc_e) {
@@ -415,11 +413,12 @@ void game_loop(heap_t *path_heap, world *world, Data *data)
 int main(int argc, char *argv[])
 {
     int manhattan_distance;
-    heap_t path_heap;
-    world *w;
+    world *w = nullptr;
     int got_data;
     Data data;
     Pokemon *starter;
+    coordinate_t pc_pos;
+    trainer *t;
 
     if (argc == 2) {
         if (strcmp(argv[1], "--numtrainers") == 0) {
@@ -454,20 +453,25 @@ int main(int argc, char *argv[])
 
         init_view();
 
-        heap_init(&path_heap, path_cmp, nullptr);
-
         place_gates(w);
         manhattan_distance = abs(w->get_location().x - START_X) + abs(w->get_location().y - START_Y);
         generate_map(w->get_current_map(), w->get_current_map()->get_n(), w->get_current_map()->get_s(), w->get_current_map()->get_w(), w->get_current_map()->get_e(), manhattan_distance);
         starter = (Pokemon *)pick_starter(&data);
         trainer_map_init(w->get_current_map(), &data, w->get_num_trainers(), (pc *)nullptr, (Pokemon *)starter, 0); 
 
-        game_loop(&path_heap, w, &data);
+        game_loop(w, &data);
 
         endwin();
 
-        heap_delete(&path_heap);
-    } 
+        // The pc belongs to no map's pools, so it is released on its own
+        pc_pos = w->get_current_map()->get_pc_pos();
+        t = w->get_current_map()->trainer_map[pc_pos.y][pc_pos.x];
+        if (t != nullptr && t->get_type() == pc_e) {
+            delete (pc *) t;
+        }
+    }
+
+    delete w;
 
     return !got_data;
 }
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "pokemon.h"
 
 Pokemon *generate_pokemon(Data *data, 
@@ -10,7 +12,8 @@ Pokemon *generate_pokemon(Data *data,
                           int defense_iv,
                           int speed_iv,
                           int special_attack_iv,
-                          int special_defense_iv)
+                          int special_defense_iv,
+                          object_pool<Pokemon> *pool)
 {
     int species_id;
     std::string name;
@@ -21,12 +24,10 @@ Pokemon *generate_pokemon(Data *data,
     int special_defense = 0;
     int speed = 0;
     int moves[2];
-    std::vector<int> move_options;
-    size_t i, j;
-    int moves_start = 0;
-    int first_move, at_end;
-    int found_move = 0;
-    int second_move;
+    size_t i;
+    size_t num_learnable;
+    size_t first_move = 0;
+    size_t second_move;
 
     species_id = data->pokemon_data[index].species_id;
     name = data->pokemon_data[index].identifier;
@@ -55,52 +56,50 @@ Pokemon *generate_pokemon(Data *data,
 
     // to get moves, level needs to be greater than or equal to level column in pokemon_moves,
     // and pokemon_move_method_id needs to be 1. then pokemon id needs to be equal to species id as well.
-    while (move_options.size() == 0) {
-        for (i = moves_start; i < data->pokemon_moves.size(); i++) {
-            if (data->pokemon_moves[i].pokemon_id == species_id) {
-                if (moves_start == 0) {
-                    moves_start = i;
-                }
-                if (data->pokemon_moves[i].level <= level && data->pokemon_moves[i].pokemon_move_method_id == 1) {
-                    if (data->pokemon_moves[i].pokemon_move_method_id == 1) {
-                        at_end = 0;
-                        j = 0;
-                        while (!at_end && move_options.size() > 0 && move_options[j] != data->pokemon_moves[i].move_id) {
-                            if (j == move_options.size() - 1) {
-                                at_end = 1;
-                            }
-                            j++;
-                        }
-                        if (at_end || move_options.size() == 0) {
-                            move_options.push_back(data->pokemon_moves[i].move_id);
-                        }
-                    }
-                }
-            }
-            if (data->pokemon_moves[i].pokemon_id > species_id) {
-                break;
-            }
+    // the learnset is sorted by level, so the learnable moves are a prefix of it. if there aren't two
+    // distinct moves yet, the pokemon is raised to the level where it learns its second one.
+    num_learnable = data->count_learnable(species_id, level);
+    if (num_learnable < 2 && (size_t) species_id < data->learnsets.size()) {
+        std::vector<LearnableMove> &learnset = data->learnsets[species_id];
+        if (learnset.size() > num_learnable) {
+            level = std::max(level, learnset[std::min(learnset.size(), (size_t) 2) - 1].level);
+            num_learnable = data->count_learnable(species_id, level);
         }
-        if (move_options.size() > 0) {
-            first_move = rand() % move_options.size();
-            if (!found_move) {
-                moves[0] = move_options[first_move];
-                found_move = 1;
-            }
-            if (move_options.size() > 1 && found_move) {
-                second_move = rand() % move_options.size();
-                while (moves[0] == move_options[second_move]) { // -1 because move ids start at 1 but array starts at 0
-                    second_move = rand() % move_options.size();
-                }
-                moves[1] = move_options[second_move];
-            } else if (move_options.size() == 1 && moves[0] == move_options[0] && moves[1] == 0) { // if there's only one move to choose from, and the first move is that move, and the 2nd move hasn't been picked yet, increment level
-                level++;
-                move_options.clear();
-            }
-        } else {
-            level++;
-            move_options.clear();
+    }
+
+    moves[0] = moves[1] = 0;
+    if (num_learnable > 0) {
+        first_move = rand() % num_learnable;
+        moves[0] = data->learnsets[species_id][first_move].move_id;
+    }
+    if (num_learnable > 1) {
+        second_move = rand() % (num_learnable - 1);
+        if (second_move >= first_move) {
+            second_move++;
         }
+        moves[1] = data->learnsets[species_id][second_move].move_id;
+    }
+
+    if (pool) {
+        return pool->create(data->pokemon_data[index].id,
+                            species_id,
+                            name,
+                            gender,
+                            is_shiny,
+                            level,
+                            hp,
+                            hp_iv,
+                            attack,
+                            attack_iv,
+                            defense,
+                            defense_iv,
+                            special_attack,
+                            special_attack_iv,
+                            special_defense,
+                            special_defense_iv,
+                            speed,
+                            speed_iv,
+                            moves);
     }
 
     return new Pokemon(data->pokemon_data[index].id,
@@ -150,11 +149,11 @@ int calculate_level(int manhattan_distance)
     distance is less than or equal to 200, minimum level is 1 and maximum level is distance / 2 (integer division).
     When distance exceeds 200, minimum level becomes (distance - 200) / 2 and maximum level is 100.
 */
-void generate_npc_party(Data *data, Pokemon *party[6], int manhattan_distance)
+void generate_npc_party(Data *data, Pokemon *party[6], int manhattan_distance, object_pool<Pokemon> *pool)
 {
     int level;
     int num_pokemon = 0;
-    while(num_pokemon == 0 || (num_pokemon <= 6 && rand() % 10 < 6)) {
+    while(num_pokemon == 0 || (num_pokemon < 6 && rand() % 10 < 6)) {
         level = calculate_level(manhattan_distance);
         party[num_pokemon] = (Pokemon *)generate_pokemon(data, 
                                                          rand() % 1092,
@@ -166,7 +165,8 @@ void generate_npc_party(Data *data, Pokemon *party[6], int manhattan_distance)
                                                          rand() % 16,
                                                          rand() % 16,
                                                          rand() % 16,
-                                                         rand() % 16);
+                                                         rand() % 16,
+                                                         pool);
         num_pokemon++;
     }
 }
@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "database.h"
+#include "pool.h"
 
 class Pokemon {
 private:
@@ -96,8 +97,9 @@ Pokemon *generate_pokemon(Data *data,
                           int defense_iv,
                           int speed_iv,
                           int special_attack_iv,
-                          int special_defense_iv);
+                          int special_defense_iv,
+                          object_pool<Pokemon> *pool = nullptr);
 
 int calculate_level(int manhattan_distance);
 
-void generate_npc_party(Data *data, Pokemon *party[6], int manhattan_distance);
+void generate_npc_party(Data *data, Pokemon *party[6], int manhattan_distance, object_pool<Pokemon> *pool);
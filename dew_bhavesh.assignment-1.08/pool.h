@@ -0,0 +1,63 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+    Typed object pool. Objects are constructed in place in fixed-size chunks owned by the pool and are
+    never freed one at a time. reset() destroys every object the pool has handed out and keeps the chunks
+    for reuse, and the chunks themselves are released when the pool is destroyed.
+*/
+template <class T, size_t chunk_size = 32>
+class object_pool {
+    private:
+        typedef typename std::aligned_storage<sizeof (T), alignof (T)>::type slot_t;
+
+        std::vector<slot_t *> chunks;
+        size_t used; // slots handed out, filled in order across the chunks
+
+        T *slot(size_t i) { return reinterpret_cast<T *>(&chunks[i / chunk_size][i % chunk_size]); }
+    public:
+        object_pool() : chunks(), used(0) {}
+        object_pool(const object_pool &) = delete;
+        object_pool &operator=(const object_pool &) = delete;
+        ~object_pool()
+        {
+            size_t i;
+
+            reset();
+            for (i = 0; i < chunks.size(); i++) {
+                delete[] chunks[i];
+            }
+        }
+
+        template <class... Args>
+        T *create(Args&&... args)
+        {
+            T *t;
+
+            if (used == chunks.size() * chunk_size) {
+                chunks.push_back(new slot_t[chunk_size]);
+            }
+            t = new (slot(used)) T(std::forward<Args>(args)...);
+            used++; // only once constructed, so a throwing constructor leaves no hole
+
+            return t;
+        }
+        void reset()
+        {
+            size_t i;
+
+            for (i = 0; i < used; i++) {
+                slot(i)->~T();
+            }
+            used = 0;
+        }
+        size_t size() const { return used; }
+};
+
+#endif
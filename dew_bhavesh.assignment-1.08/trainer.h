@@ -64,7 +64,13 @@ class pc : public trainer {
             party[0] = starter;
         };
         explicit pc(trainer *t) : trainer(t) {}
-        ~pc() {}
+        ~pc()
+        {
+            int i;
+            for (i = 0; i < 6; i++) {
+                delete party[i];
+            }
+        }
         void add_pokemon(Pokemon *p) 
         {
             int i;
@@ -109,7 +115,7 @@ class npc : public trainer {
                     break;
             }
         }
-        npc(Data *data, trainer_type_e t, int manhattan_distance) : trainer(t) 
+        npc(Data *data, trainer_type_e t, int manhattan_distance, object_pool<Pokemon> *pokemon_pool) : trainer(t) 
         {
             switch (t)
             {
@@ -138,7 +144,7 @@ class npc : public trainer {
                     seq_num = 0;
                     break;
             }
-            generate_npc_party(data, party, manhattan_distance);
+            generate_npc_party(data, party, manhattan_distance, pokemon_pool);
         }
         ~npc() {}
 };
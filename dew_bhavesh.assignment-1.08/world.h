@@ -11,35 +11,18 @@ class world {
         int num_trainers;
     public:
         map *board[WORLD_HEIGHT][WORLD_WIDTH];
-        path hiker_path[MAP_HEIGHT][MAP_WIDTH];
-        path rival_path[MAP_HEIGHT][MAP_WIDTH];
-        explicit world(int num_t) : location(), board()
+        path hiker_path;
+        path rival_path;
+        path swimmer_path;
+        explicit world(int num_t) : location(), board(), hiker_path(hiker_e), rival_path(rival_e), swimmer_path(swimmer_e)
         {
             int x, y;
-            coordinate_t tmp;
             for (y = 0; y < WORLD_HEIGHT; y++) {
                 for (x = 0; x < WORLD_WIDTH; x++) {
                     board[y][x] = nullptr;
                 }
             }
 
-            for (y = 0; y < MAP_HEIGHT; y++) {
-                for (x = 0; x < MAP_WIDTH; x++) {
-                    tmp.y = y;
-                    tmp.x = x;
-                    hiker_path[y][x].set_heap_node(nullptr);
-                    hiker_path[y][x].set_coordinate(tmp);
-                    hiker_path[y][x].set_terrain(edge);
-                    hiker_path[y][x].set_terrain_cost(INT_MAX);
-                    hiker_path[y][x].set_cost(INT_MAX);
-
-                    rival_path[y][x].set_heap_node(nullptr);
-                    rival_path[y][x].set_coordinate(tmp);
-                    rival_path[y][x].set_terrain(edge);
-                    rival_path[y][x].set_terrain_cost(INT_MAX);
-                    rival_path[y][x].set_cost(INT_MAX);
-                }
-            }
             location.x = START_X;
             location.y = START_Y;
             num_trainers = num_t;
@@ -53,9 +36,7 @@ class world {
 
             for (y = 0; y < WORLD_HEIGHT; y++) {
                 for (x = 0; x < WORLD_WIDTH; x++) {
-                    if (board[y][x] != nullptr) {
-                        board[y][x]->~map();
-                    }
+                    delete board[y][x];
                 }
             }
         }
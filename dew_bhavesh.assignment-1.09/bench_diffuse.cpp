@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "poke327.h"
+#include "diffuse.h"
+
+/* Benchmarks diffuse() against the malloc()ed linked list queue that   *
+ * smooth_height() and map_terrain() each used to run, with the same    *
+ * rules: heights flood all 8 neighbors, and terrain spreads east and   *
+ * west (80%) or north and south (20%), retrying a cell once per visit. *
+ * Both draw from identical streams, so every grid must come out the    *
+ * same; the exit status says whether it did.                           */
+
+static unsigned int stream;
+
+typedef struct queue_node {
+  int x, y;
+  struct queue_node *next;
+} queue_node_t;
+
+/* The old passes, kept as the baseline */
+static void push(queue_node_t **head, queue_node_t **tail, int x, int y)
+{
+  queue_node_t *n = (queue_node_t *) malloc(sizeof (*n));
+
+  n->next = NULL;
+  n->x = x;
+  n->y = y;
+  if (*head) {
+    (*tail)->next = n;
+  } else {
+    *head = n;
+  }
+  *tail = n;
+}
+
+static void list_heights(uint8_t grid[MAP_Y][MAP_X], queue_node_t *head,
+                         queue_node_t *tail)
+{
+  queue_node_t *tmp;
+  int x, y, dx, dy, i;
+
+  while (head) {
+    x = head->x;
+    y = head->y;
+    i = grid[y][x];
+
+    for (dx = -1; dx <= 1; dx++) {
+      for (dy = -1; dy <= 1; dy++) {
+        if ((dx || dy) &&
+            x + dx >= 0 && x + dx < MAP_X && y + dy >= 0 && y + dy < MAP_Y &&
+            !grid[y + dy][x + dx]) {
+          grid[y + dy][x + dx] = i;
+          push(&head, &tail, x + dx, y + dy);
+        }
+      }
+    }
+
+    tmp = head;
+    head = head->next;
+    free(tmp);
+  }
+}
+
+static void list_terrain(uint8_t grid[MAP_Y][MAP_X], queue_node_t *head,
+                         queue_node_t *tail)
+{
+  static const int dirs[4][2] = { { -1, 0 }, { 0, -1 }, { 0, 1 }, { 1, 0 } };
+  queue_node_t *tmp;
+  int x, y, nx, ny, d, i;
+  int added_current;
+
+  while (head) {
+    x = head->x;
+    y = head->y;
+    i = grid[y][x];
+    added_current = 0;
+
+    for (d = 0; d < 4; d++) {
+      nx = x + dirs[d][0];
+      ny = y + dirs[d][1];
+      if (nx >= 0 && nx < MAP_X && ny >= 0 && ny < MAP_Y && !grid[ny][nx]) {
+        if ((rand_r(&stream) % 100) < (dirs[d][0] ? 80 : 20)) {
+          grid[ny][nx] = i;
+          push(&head, &tail, nx, ny);
+        } else if (!added_current) {
+          added_current = 1;
+          push(&head, &tail, x, y);
+        }
+      }
+    }
+
+    tmp = head;
+    head = head->next;
+    free(tmp);
+  }
+}
+
+/* The same rules, for diffuse(), in the old passes' neighbor order */
+static const pair_t height_dirs[8] = {
+  { -1, -1 }, { -1,  0 }, { -1,  1 },
+  {  0, -1 },             {  0,  1 },
+  {  1, -1 }, {  1,  0 }, {  1,  1 }
+};
+
+static const diffuse_rule_t height_diffusion = {
+  height_dirs, 8, NULL, 0
+};
+
+static const pair_t terrain_dirs[4] = {
+  { -1,  0 },
+  {  0, -1 },
+  {  0,  1 },
+  {  1,  0 },
+};
+
+static int terrain_accept(uint32_t d)
+{
+  return (rand_r(&stream) % 100) < (terrain_dirs[d][dim_x] ? 80 : 20);
+}
+
+static const diffuse_rule_t terrain_diffusion = {
+  terrain_dirs, 4, terrain_accept, 1
+};
+
+/* Seeds as smooth_height() does: values 1, 21, ... 241 */
+static void height_seeds(unsigned int seed, int16_t x[], int16_t y[],
+                         uint32_t *num)
+{
+  uint8_t used[MAP_Y][MAP_X];
+
+  memset(used, 0, sizeof (used));
+  for (*num = 0; *num < 13; (*num)++) {
+    do {
+      x[*num] = rand_r(&seed) % MAP_X;
+      y[*num] = rand_r(&seed) % MAP_Y;
+    } while (used[y[*num]][x[*num]]);
+    used[y[*num]][x[*num]] = 1;
+  }
+}
+
+/* Seeds as map_terrain() does: 2-5 regions of each of five types */
+static void terrain_seeds(unsigned int seed, int16_t x[], int16_t y[],
+                          uint8_t value[], uint32_t *num)
+{
+  uint8_t used[MAP_Y][MAP_X];
+  uint32_t type, n;
+
+  memset(used, 0, sizeof (used));
+  for (*num = 0, type = 1; type <= 5; type++) {
+    for (n = rand_r(&seed) % 4 + 2; n; n--, (*num)++) {
+      do {
+        x[*num] = rand_r(&seed) % (MAP_X - 2) + 1;
+        y[*num] = rand_r(&seed) % (MAP_Y - 2) + 1;
+      } while (used[y[*num]][x[*num]]);
+      used[y[*num]][x[*num]] = 1;
+      value[*num] = type;
+    }
+  }
+}
+
+static double now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  uint8_t a[MAP_Y][MAP_X], b[MAP_Y][MAP_X];
+  int16_t x[25], y[25];
+  uint8_t value[25];
+  uint32_t num_maps, seed, i, j, num, mismatches;
+  double t, list_time[2], diffuse_time[2];
+  queue_node_t *head, *tail;
+  diffuse_queue_t q;
+
+  num_maps = argc > 1 ? atoi(argv[1]) : 20000;
+  seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 327;
+
+  memset(list_time, 0, sizeof (list_time));
+  memset(diffuse_time, 0, sizeof (diffuse_time));
+  mismatches = 0;
+  for (i = 0; i < num_maps; i++) {
+    /* Heights */
+    height_seeds(seed + i, x, y, &num);
+
+    t = now();
+    memset(a, 0, sizeof (a));
+    for (head = tail = NULL, j = 0; j < num; j++) {
+      a[y[j]][x[j]] = 1 + 20 * j;
+      push(&head, &tail, x[j], y[j]);
+    }
+    list_heights(a, head, tail);
+    list_time[0] += now() - t;
+
+    t = now();
+    memset(b, 0, sizeof (b));
+    diffuse_init(&q);
+    for (j = 0; j < num; j++) {
+      diffuse_seed(&q, b, x[j], y[j], 1 + 20 * j);
+    }
+    diffuse(&q, b, &height_diffusion);
+    diffuse_time[0] += now() - t;
+
+    mismatches += !!memcmp(a, b, sizeof (a));
+
+    /* Terrain */
+    terrain_seeds(seed + i, x, y, value, &num);
+
+    stream = seed + i;
+    t = now();
+    memset(a, 0, sizeof (a));
+    for (head = tail = NULL, j = 0; j < num; j++) {
+      a[y[j]][x[j]] = value[j];
+      push(&head, &tail, x[j], y[j]);
+    }
+    list_terrain(a, head, tail);
+    list_time[1] += now() - t;
+
+    stream = seed + i;
+    t = now();
+    memset(b, 0, sizeof (b));
+    diffuse_init(&q);
+    for (j = 0; j < num; j++) {
+      diffuse_seed(&q, b, x[j], y[j], value[j]);
+    }
+    diffuse(&q, b, &terrain_diffusion);
+    diffuse_time[1] += now() - t;
+
+    mismatches += !!memcmp(a, b, sizeof (a));
+  }
+
+  printf("%u maps, seed %u; us per map\n", num_maps, seed);
+  printf("%-8s %12s %12s %8s\n", "pass", "linked list", "diffuse()", "speedup");
+  printf("%-8s %12.2f %12.2f %7.2fx\n", "height",
+         list_time[0] * 1e6 / num_maps, diffuse_time[0] * 1e6 / num_maps,
+         list_time[0] / diffuse_time[0]);
+  printf("%-8s %12.2f %12.2f %7.2fx\n", "terrain",
+         list_time[1] * 1e6 / num_maps, diffuse_time[1] * 1e6 / num_maps,
+         list_time[1] / diffuse_time[1]);
+  printf("Grids differ on %u of %u passes\n", mismatches, 2 * num_maps);
+
+  return mismatches ? 1 : 0;
+}
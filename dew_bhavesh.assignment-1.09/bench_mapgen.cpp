@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "poke327.h"
+#include "mapgen.h"
+
+/* Generates maps with generate_map() itself, profiled phase by phase, *
+ * and reports the distribution of each phase's time per map and the   *
+ * allocations it makes.  The maps and the world seed are fixed, so    *
+ * runs are comparable; with -l, the exit status says whether the mean *
+ * time per map stayed under a limit.                                  */
+
+world_t world;
+
+/* Every allocation, C or C++, ends up in one of these */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+static uint64_t allocations;
+
+extern "C" void *malloc(size_t size) noexcept
+{
+  allocations++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) noexcept
+{
+  allocations++;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) noexcept
+{
+  allocations++;
+  return __libc_realloc(p, size);
+}
+
+static uint64_t count_allocations()
+{
+  return allocations;
+}
+
+static uint64_t now_ns()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double percentile(std::vector<uint64_t> &v, double p)
+{
+  return v[(size_t) (p * (v.size() - 1) + 0.5)] / 1000.0;
+}
+
+static void report(const char *name, std::vector<uint64_t> &ns,
+                   uint64_t allocs, uint32_t num_maps)
+{
+  uint64_t total;
+  size_t i;
+
+  std::sort(ns.begin(), ns.end());
+  for (total = i = 0; i < ns.size(); i++) {
+    total += ns[i];
+  }
+
+  printf("%-18s %9.1f %9.1f %9.1f %9.1f %9.1f %10.1f\n", name,
+         total / 1000.0 / num_maps, percentile(ns, 0.5),
+         percentile(ns, 0.9), percentile(ns, 0.99), percentile(ns, 1.0),
+         (double) allocs / num_maps);
+}
+
+void usage(char *s)
+{
+  fprintf(stderr, "Usage: %s [-n|--maps <count>] [-s|--seed <seed>] "
+          "[-l|--limit <us per map>]\n"
+          "       [-t|--terrain <diffuse|voronoi>]\n"
+          "       [-p|--passes <smoothing passes>]\n", s);
+
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<uint64_t> ns[num_mapgen_phases], total_ns;
+  std::vector<npc *> trainers;
+  uint64_t allocs[num_mapgen_phases], total_allocs, start, a;
+  dist_maps_t dist;
+  mapgen_profile_t profile;
+  uint32_t num_maps, seed, limit, passes, i, j;
+  double mean;
+  int long_arg;
+  int terrain;
+  pair_t idx;
+  map_t *m;
+
+  num_maps = 1000;
+  seed = 327;
+  limit = 0;
+
+  for (i = 1, long_arg = 0; i < (uint32_t) argc; i++, long_arg = 0) {
+    if (argv[i][0] != '-') {
+      usage(argv[0]);
+    }
+    if (argv[i][1] == '-') {
+      argv[i]++;
+      long_arg = 1;
+    }
+    switch (argv[i][1]) {
+    case 'n':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-maps")) ||
+          (uint32_t) argc < ++i + 1 ||
+          !sscanf(argv[i], "%u", &num_maps) || !num_maps) {
+        usage(argv[0]);
+      }
+      break;
+    case 's':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-seed")) ||
+          (uint32_t) argc < ++i + 1 ||
+          !sscanf(argv[i], "%u", &seed)) {
+        usage(argv[0]);
+      }
+      break;
+    case 'l':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-limit")) ||
+          (uint32_t) argc < ++i + 1 ||
+          !sscanf(argv[i], "%u", &limit)) {
+        usage(argv[0]);
+      }
+      break;
+    case 't':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-terrain")) ||
+          (uint32_t) argc < ++i + 1 ||
+          (terrain = terrain_mode_parse(argv[i])) < 0) {
+        usage(argv[0]);
+      }
+      mapgen_set_terrain_mode((terrain_mode_t) terrain);
+      break;
+    case 'p':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-passes")) ||
+          (uint32_t) argc < ++i + 1 ||
+          !sscanf(argv[i], "%u", &passes) || !passes) {
+        usage(argv[0]);
+      }
+      mapgen_set_smooth_passes(passes);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  world.seed = seed;
+  memset(allocs, 0, sizeof (allocs));
+  total_allocs = 0;
+  profile.allocations = count_allocations;
+  mapgen_set_profile(&profile);
+
+  for (i = 0; i < num_maps; i++) {
+    /* Spread over the world, since distance from the center matters */
+    idx[dim_x] = (i * 37) % WORLD_SIZE;
+    idx[dim_y] = (i * 101 + i / WORLD_SIZE) % WORLD_SIZE;
+
+    memset(profile.ns, 0, sizeof (profile.ns));
+    memset(profile.allocs, 0, sizeof (profile.allocs));
+    trainers.clear();
+    a = allocations;
+    start = now_ns();
+    m = (map_t *) malloc(sizeof (*m));
+    generate_map(m, idx, &dist, trainers);
+    /* Before push_back(), which may allocate */
+    total_allocs += allocations - a;
+    total_ns.push_back(now_ns() - start);
+    map_delete(m);
+
+    for (j = 0; j < num_mapgen_phases; j++) {
+      ns[j].push_back(profile.ns[j]);
+      allocs[j] += profile.allocs[j];
+    }
+  }
+  mapgen_set_profile(NULL);
+
+  printf("%u maps, seed %u, %s terrain, %u smoothing passes; "
+         "times in us per map\n", num_maps, seed,
+         terrain_mode_name[mapgen_terrain_mode()], mapgen_smooth_passes());
+  printf("%-18s %9s %9s %9s %9s %9s %10s\n",
+         "phase", "mean", "p50", "p90", "p99", "max", "allocs");
+  for (j = 0; j < num_mapgen_phases; j++) {
+    report(mapgen_phase_name[j], ns[j], allocs[j], num_maps);
+  }
+  report("generate_map", total_ns, total_allocs, num_maps);
+
+  if (limit) {
+    for (mean = 0, i = 0; i < num_maps; i++) {
+      mean += total_ns[i] / 1000.0 / num_maps;
+    }
+    if (mean > limit) {
+      printf("Mean %.1f us per map is over the limit of %u us\n", mean, limit);
+      return 1;
+    }
+  }
+
+  return 0;
+}
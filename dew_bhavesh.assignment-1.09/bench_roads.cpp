@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include <vector>
+
+#include "heap.h"
+#include "poke327.h"
+#include "mapgen.h"
+
+/* Benchmarks the road router against the Fibonacci heap Dijkstra it    *
+ * replaced, on the terrain of real maps.  Every route is checked: the  *
+ * router must find one as cheap as Dijkstra's on the same terrain.     *
+ * Where there are equal-cost choices the two may take different ones,  *
+ * so finished roads are compared and reported, but only costs decide   *
+ * the exit status.                                                      */
+
+world_t world;
+
+static int32_t edge_penalty(int8_t x, int8_t y)
+{
+  return (x == 1 || y == 1 || x == MAP_X - 2 || y == MAP_Y - 2) ? 2 : 1;
+}
+
+/* The router as it was, kept as the baseline */
+static int32_t path_cmp(const void *key, const void *with) {
+  return ((path_t *) key)->cost - ((path_t *) with)->cost;
+}
+
+static uint32_t dijkstra_path(mapgen_t *m, pair_t from, pair_t to)
+{
+  static thread_local path_t path[MAP_Y][MAP_X];
+  static thread_local uint32_t initialized = 0;
+  path_t *p;
+  heap_t h;
+  int32_t x, y;
+
+  if (!initialized) {
+    for (y = 0; y < MAP_Y; y++) {
+      for (x = 0; x < MAP_X; x++) {
+        path[y][x].pos[dim_y] = y;
+        path[y][x].pos[dim_x] = x;
+      }
+    }
+    initialized = 1;
+  }
+  
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      path[y][x].cost = INT_MAX;
+    }
+  }
+
+  path[from[dim_y]][from[dim_x]].cost = 0;
+
+  heap_init(&h, path_cmp, NULL);
+
+  for (y = 1; y < MAP_Y - 1; y++) {
+    for (x = 1; x < MAP_X - 1; x++) {
+      path[y][x].hn = heap_insert(&h, &path[y][x]);
+    }
+  }
+
+  while ((p = (path_t *) heap_remove_min(&h))) {
+    p->hn = NULL;
+
+    if ((p->pos[dim_y] == to[dim_y]) && p->pos[dim_x] == to[dim_x]) {
+      for (x = to[dim_x], y = to[dim_y];
+           (x != from[dim_x]) || (y != from[dim_y]);
+           p = &path[y][x], x = p->from[dim_x], y = p->from[dim_y]) {
+        mapxy(x, y) = ter_path;
+        heightxy(x, y) = 0;
+      }
+      heap_delete(&h);
+      return path[to[dim_y]][to[dim_x]].cost;
+    }
+
+    if ((path[p->pos[dim_y] - 1][p->pos[dim_x]    ].hn) &&
+        (path[p->pos[dim_y] - 1][p->pos[dim_x]    ].cost >
+         ((p->cost + heightpair(p->pos)) *
+          edge_penalty(p->pos[dim_x], p->pos[dim_y] - 1)))) {
+      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].cost =
+        ((p->cost + heightpair(p->pos)) *
+         edge_penalty(p->pos[dim_x], p->pos[dim_y] - 1));
+      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].from[dim_y] = p->pos[dim_y];
+      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].from[dim_x] = p->pos[dim_x];
+      heap_decrease_key_no_replace(&h, path[p->pos[dim_y] - 1]
+                                           [p->pos[dim_x]    ].hn);
+    }
+    if ((path[p->pos[dim_y]    ][p->pos[dim_x] - 1].hn) &&
+        (path[p->pos[dim_y]    ][p->pos[dim_x] - 1].cost >
+         ((p->cost + heightpair(p->pos)) *
+          edge_penalty(p->pos[dim_x] - 1, p->pos[dim_y])))) {
+      path[p->pos[dim_y]][p->pos[dim_x] - 1].cost =
+        ((p->cost + heightpair(p->pos)) *
+         edge_penalty(p->pos[dim_x] - 1, p->pos[dim_y]));
+      path[p->pos[dim_y]    ][p->pos[dim_x] - 1].from[dim_y] = p->pos[dim_y];
+      path[p->pos[dim_y]    ][p->pos[dim_x] - 1].from[dim_x] = p->pos[dim_x];
+      heap_decrease_key_no_replace(&h, path[p->pos[dim_y]    ]
+                                           [p->pos[dim_x] - 1].hn);
+    }
+    if ((path[p->pos[dim_y]    ][p->pos[dim_x] + 1].hn) &&
+        (path[p->pos[dim_y]    ][p->pos[dim_x] + 1].cost >
+         ((p->cost + heightpair(p->pos)) *
+          edge_penalty(p->pos[dim_x] + 1, p->pos[dim_y])))) {
+      path[p->pos[dim_y]][p->pos[dim_x] + 1].cost =
+        ((p->cost + heightpair(p->pos)) *
+         edge_penalty(p->pos[dim_x] + 1, p->pos[dim_y]));
+      path[p->pos[dim_y]    ][p->pos[dim_x] + 1].from[dim_y] = p->pos[dim_y];
+      path[p->pos[dim_y]    ][p->pos[dim_x] + 1].from[dim_x] = p->pos[dim_x];
+      heap_decrease_key_no_replace(&h, path[p->pos[dim_y]    ]
+                                           [p->pos[dim_x] + 1].hn);
+    }
+    if ((path[p->pos[dim_y] + 1][p->pos[dim_x]    ].hn) &&
+        (path[p->pos[dim_y] + 1][p->pos[dim_x]    ].cost >
+         ((p->cost + heightpair(p->pos)) *
+          edge_penalty(p->pos[dim_x], p->pos[dim_y] + 1)))) {
+      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].cost =
+        ((p->cost + heightpair(p->pos)) *
+         edge_penalty(p->pos[dim_x], p->pos[dim_y] + 1));
+      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].from[dim_y] = p->pos[dim_y];
+      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].from[dim_x] = p->pos[dim_x];
+      heap_decrease_key_no_replace(&h, path[p->pos[dim_y] + 1]
+                                           [p->pos[dim_x]    ].hn);
+    }
+  }
+
+  return UINT32_MAX;
+}
+
+static std::vector<uint32_t> route_costs;
+
+static uint32_t baseline_route(mapgen_t *m, pair_t from, pair_t to)
+{
+  uint32_t c = dijkstra_path(m, from, to);
+
+  route_costs.push_back(c);
+
+  return c;
+}
+
+static uint32_t astar_route(mapgen_t *m, pair_t from, pair_t to)
+{
+  uint32_t c = astar_path(m, from, to);
+
+  route_costs.push_back(c);
+
+  return c;
+}
+
+/* Routes with both, on the terrain as the router has left it so far, *
+ * and lays the router's road.  Records routes whose costs differ.     */
+static uint32_t checked_routes, checked_mismatches, checked_same_roads;
+
+static uint32_t checked_route(mapgen_t *m, pair_t from, pair_t to)
+{
+  static mapgen_t baseline;
+  uint32_t c;
+
+  baseline = *m;
+  c = astar_path(m, from, to);
+  checked_routes++;
+  checked_mismatches += c != dijkstra_path(&baseline, from, to);
+  checked_same_roads += !memcmp(m->map, baseline.map, sizeof (m->map));
+
+  return c;
+}
+
+static double now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<uint32_t> baseline_costs;
+  uint32_t num_maps, i, j, routes, cost_mismatches, same_roads;
+  double t, baseline_time, astar_time;
+  mapgen_t g, a, b;
+  pair_t idx;
+
+  num_maps = argc > 1 ? atoi(argv[1]) : 2000;
+  world.seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 327;
+
+  baseline_time = astar_time = 0;
+  routes = cost_mismatches = same_roads = 0;
+  for (i = 0; i < num_maps; i++) {
+    idx[dim_x] = i % WORLD_SIZE;
+    idx[dim_y] = (i / WORLD_SIZE) % WORLD_SIZE;
+
+    generate_map_roadless(&g, idx);
+    a = b = g;
+
+    route_costs.clear();
+    t = now();
+    generate_roads(&a, baseline_route);
+    baseline_time += now() - t;
+    baseline_costs = route_costs;
+
+    route_costs.clear();
+    t = now();
+    generate_roads(&b, astar_route);
+    astar_time += now() - t;
+
+    /* Each route against the baseline's, road for road */
+    for (j = 0; j < route_costs.size(); j++) {
+      cost_mismatches += route_costs[j] != baseline_costs[j];
+    }
+    routes += route_costs.size();
+    same_roads += !memcmp(a.map, b.map, sizeof (a.map));
+
+    generate_roads(&g, checked_route);
+  }
+
+  printf("%u maps, %u routes, seed %u\n", num_maps, routes, world.seed);
+  printf("Fibonacci heap Dijkstra: %8.2f us/map\n",
+         baseline_time * 1e6 / num_maps);
+  printf("Radix heap A*:           %8.2f us/map (%.2fx)\n",
+         astar_time * 1e6 / num_maps, baseline_time / astar_time);
+  printf("Laid independently: roads identical on %u maps, "
+         "route cost differs on %u routes\n", same_roads, cost_mismatches);
+  printf("On the same terrain:  route identical on %u routes, "
+         "cost differs on %u routes\n",
+         checked_same_roads, checked_mismatches);
+
+  return checked_mismatches ? 1 : 0;
+}
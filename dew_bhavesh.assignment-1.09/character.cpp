@@ -3,21 +3,6 @@
 #include "poke327.h"
 #include "io.h"
 
-/***********************************************************************
- * Hack: Avoid the "path to a building" issue by making building cells *
- * have a large but not infinite movement cost.  This allows the       *
- * pathfinding algorithm to run without overflowing, but still makes   *
- * NPCs avoid buildings most of the time since the cost to move on to  *
- * the building is greater than navigating the building's perimeter.   *
- ***********************************************************************/
-int32_t move_cost[num_character_types][num_terrain_types] = {
-  { INT_MAX, INT_MAX, 10, 10, 10, 20, 10, INT_MAX, INT_MAX, INT_MAX, 10      },
-  { INT_MAX, INT_MAX, 10, 50, 50, 15, 10, 15,      15,     INT_MAX, INT_MAX },
-  { INT_MAX, INT_MAX, 10, 50, 50, 20, 10, INT_MAX, INT_MAX,INT_MAX, INT_MAX },
-   { INT_MAX, INT_MAX,  7, INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX,  7, INT_MAX },
-  { INT_MAX, INT_MAX, 10, 50, 50, 20, 10, INT_MAX, INT_MAX,INT_MAX, INT_MAX },
-};
-
 const char *char_type_name[num_character_types] = {
   "PC",
   "Hiker",
@@ -26,104 +11,46 @@ const char *char_type_name[num_character_types] = {
   "Trainer",
 };
 
-#define is_adjacent(pos, ter)                                \
-  ((world.cur_map->map[pos[dim_y] - 1][pos[dim_x] - 1] == ter) || \
-   (world.cur_map->map[pos[dim_y] - 1][pos[dim_x]    ] == ter) || \
-   (world.cur_map->map[pos[dim_y] - 1][pos[dim_x] + 1] == ter) || \
-   (world.cur_map->map[pos[dim_y]    ][pos[dim_x] - 1] == ter) || \
-   (world.cur_map->map[pos[dim_y]    ][pos[dim_x] + 1] == ter) || \
-   (world.cur_map->map[pos[dim_y] + 1][pos[dim_x] - 1] == ter) || \
-   (world.cur_map->map[pos[dim_y] + 1][pos[dim_x]    ] == ter) || \
-   (world.cur_map->map[pos[dim_y] + 1][pos[dim_x] + 1] == ter))
-
 void pathfind(map_t *m);
 
-uint32_t can_see(map_t *m, character *voyeur, character *exhibitionist)
+/* Can the swimmer c see the PC?  Only while the PC is on the shore,  *
+ * and only from right beside it.  Both are lookups, and the same from *
+ * either end, which a line walked between the two isn't.              */
+static int swimmer_sees_pc(const water_labels_t *w, character *c)
 {
-  /* Application of Bresenham's Line Drawing Algorithm.  If we can draw a   *
-   * line from v to e without intersecting any foreign terrain, then v can  *
-   * see * e.  Unfortunately, Bresenham isn't symmetric, so line-of-sight   *
-   * based on this approach is not reciprocal (Helmholtz Reciprocity).      *
-   * This is a very real problem in roguelike games, and one we're going to *
-   * ignore for now.  Algorithms that are symmetrical are far more          *
-   * expensive.                                                             */
-
-  /* Adapted from rlg327.  For the purposes of poke327, can swimmers see    *
-   * the PC adjacent to water or on a bridge?  v is always a swimmer, and e *
-   * is always the player character.                                        */
-
-  pair_t first, second;
-  pair_t del, f;
-  int16_t a, b, c, i;
-
-  first[dim_x] = voyeur->pos[dim_x];
-  first[dim_y] = voyeur->pos[dim_y];
-  second[dim_x] = exhibitionist->pos[dim_x];
-  second[dim_y] = exhibitionist->pos[dim_y];
-
-  if (second[dim_x] > first[dim_x]) {
-    del[dim_x] = second[dim_x] - first[dim_x];
-    f[dim_x] = 1;
-  } else {
-    del[dim_x] = first[dim_x] - second[dim_x];
-    f[dim_x] = -1;
-  }
+  return (water_shore(w, world.pc.pos[dim_x], world.pc.pos[dim_y]) &&
+          abs(c->pos[dim_x] - world.pc.pos[dim_x]) <= 1 &&
+          abs(c->pos[dim_y] - world.pc.pos[dim_y]) <= 1);
+}
 
-  if (second[dim_y] > first[dim_y]) {
-    del[dim_y] = second[dim_y] - first[dim_y];
-    f[dim_y] = 1;
-  } else {
-    del[dim_y] = first[dim_y] - second[dim_y];
-    f[dim_y] = -1;
-  }
+/* Takes the step in the flow field for ctype if nothing is in the way. *
+ * Otherwise, or if the step is onto the cell the distances are from,  *
+ * which means a battle, the NPC looks around for itself.              */
+static int flow_step(character *c, character_type_t ctype, pair_t dest)
+{
+  uint8_t d;
 
-  if (del[dim_x] > del[dim_y]) {
-    a = del[dim_y] + del[dim_y];
-    c = a - del[dim_x];
-    b = c - del[dim_x];
-    for (i = 0; i <= del[dim_x]; i++) {
-      if (((mappair(first) != ter_water) || (mappair(first) != ter_path)) &&
-          i && (i != del[dim_x])) {
-        return 0;
-      }
-      first[dim_x] += f[dim_x];
-      if (c < 0) {
-        c += a;
-      } else {
-        c += b;
-        first[dim_y] += f[dim_y];
-      }
-    }
-    return 1;
-  } else {
-    a = del[dim_x] + del[dim_x];
-    c = a - del[dim_y];
-    b = c - del[dim_y];
-    for (i = 0; i <= del[dim_y]; i++) {
-      if (((mappair(first) != ter_water) || (mappair(first) != ter_path)) &&
-          i && (i != del[dim_y])) {
-        return 0;
-      }
-      first[dim_y] += f[dim_y];
-      if (c < 0) {
-        c += a;
-      } else {
-        c += b;
-        first[dim_x] += f[dim_x];
-      }
-    }
-    return 1;
+  if ((d = pathfind_flow(ctype)[c->pos[dim_y]][c->pos[dim_x]]) == FLOW_NONE) {
+    return 0;
   }
+  dest[dim_x] = c->pos[dim_x] + all_dirs[d][dim_x];
+  dest[dim_y] = c->pos[dim_y] + all_dirs[d][dim_y];
 
-  return 1;
+  return (!world.cur_map->cmap[dest[dim_y]][dest[dim_x]] &&
+          pathfind_dist(ctype)[dest[dim_y]][dest[dim_x]]);
 }
 
 static void move_hiker_func(character *c, pair_t dest)
 {
+  const int (*dist)[MAP_X] = pathfind_dist(char_hiker);
   int min;
   int base;
   int i;
 
+  if (flow_step(c, char_hiker, dest)) {
+    return;
+  }
+
   base = rand() & 0x7;
 
   dest[dim_x] = c->pos[dim_x];
@@ -131,17 +58,17 @@ static void move_hiker_func(character *c, pair_t dest)
   min = INT_MAX;
   
   for (i = base; i < 8 + base; i++) {
-    if ((world.hiker_dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                         [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] <=
+    if ((dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
+              [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] <=
          min) &&
         !world.cur_map->cmap[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
                             [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]]) {
       dest[dim_x] = c->pos[dim_x] + all_dirs[i & 0x7][dim_x];
       dest[dim_y] = c->pos[dim_y] + all_dirs[i & 0x7][dim_y];
-      min = world.hiker_dist[dest[dim_y]][dest[dim_x]];
+      min = dist[dest[dim_y]][dest[dim_x]];
     }
-    if (world.hiker_dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                        [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] == 0) {
+    if (dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
+            [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] == 0) {
       io_battle(c, &world.pc);
       break;
     }
@@ -150,10 +77,15 @@ static void move_hiker_func(character *c, pair_t dest)
 
 static void move_rival_func(character *c, pair_t dest)
 {
+  const int (*dist)[MAP_X] = pathfind_dist(char_rival);
   int min;
   int base;
   int i;
-  
+
+  if (flow_step(c, char_rival, dest)) {
+    return;
+  }
+
   base = rand() & 0x7;
 
   dest[dim_x] = c->pos[dim_x];
@@ -161,17 +93,17 @@ static void move_rival_func(character *c, pair_t dest)
   min = INT_MAX;
   
   for (i = base; i < 8 + base; i++) {
-    if ((world.rival_dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                         [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] <
+    if ((dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
+              [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] <
          min) &&
         !world.cur_map->cmap[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
                             [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]]) {
       dest[dim_x] = c->pos[dim_x] + all_dirs[i & 0x7][dim_x];
       dest[dim_y] = c->pos[dim_y] + all_dirs[i & 0x7][dim_y];
-      min = world.rival_dist[dest[dim_y]][dest[dim_x]];
+      min = dist[dest[dim_y]][dest[dim_x]];
     }
-    if (world.rival_dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
-                        [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] == 0) {
+    if (dist[c->pos[dim_y] + all_dirs[i & 0x7][dim_y]]
+            [c->pos[dim_x] + all_dirs[i & 0x7][dim_x]] == 0) {
       io_battle(c, &world.pc);
       break;
     }
@@ -291,16 +223,14 @@ static void move_walker_func(character *c, pair_t dest)
 
 static void move_swimmer_func(character *c, pair_t dest)
 {
-  npc *n = dynamic_cast<npc *> (c);
-
   map_t *m = world.cur_map;
+  const water_labels_t *w = &m->water;
   pair_t dir; 
 
   dest[dim_x] = c->pos[dim_x];
   dest[dim_y] = c->pos[dim_y];
 
-  if (is_adjacent(world.pc.pos, ter_water) &&
-      can_see(world.cur_map, c, &world.pc)) {
+  if (swimmer_sees_pc(w, c)) {
     /* PC is next to this body of water; swim to the PC */
 
     dir[dim_x] = c->pos[dim_x] - world.pc.pos[dim_x];
@@ -312,48 +242,19 @@ static void move_swimmer_func(character *c, pair_t dest)
       dir[dim_y] /= abs(dir[dim_y]);
     }
 
-    if ((m->map[dest[dim_y] + dir[dim_y]]
-               [dest[dim_x] + dir[dim_x]] == ter_water) ||
-        ((m->map[dest[dim_y] + dir[dim_y]]
-                [dest[dim_x] + dir[dim_x]] == ter_path) &&
-         is_adjacent(((pair_t){ (int16_t) (dest[dim_x] + dir[dim_x]),
-                                (int16_t) (dest[dim_y] + dir[dim_y]) }),
-                     ter_water))) {
+    if (w->body[dest[dim_y] + dir[dim_y]][dest[dim_x] + dir[dim_x]]) {
       dest[dim_x] += dir[dim_x];
       dest[dim_y] += dir[dim_y];
-    } else if ((m->map[dest[dim_y]][dest[dim_x] + dir[dim_x]] == ter_water) ||
-               ((m->map[dest[dim_y]][dest[dim_x] + dir[dim_x]] == ter_path) &&
-                is_adjacent(((pair_t){ (int16_t) (dest[dim_x] + dir[dim_x]),
-                                       (dest[dim_y]) }), ter_water))) {
+    } else if (w->body[dest[dim_y]][dest[dim_x] + dir[dim_x]]) {
       dest[dim_x] += dir[dim_x];
-    } else if ((m->map[dest[dim_y] + dir[dim_y]][dest[dim_x]] == ter_water) ||
-               ((m->map[dest[dim_y] + dir[dim_y]][dest[dim_x]] == ter_path) &&
-                is_adjacent(((pair_t){ (dest[dim_x]),
-                                       (int16_t) (dest[dim_y] + dir[dim_y]) }),
-                            ter_water))) {
+    } else if (w->body[dest[dim_y] + dir[dim_y]][dest[dim_x]]) {
       dest[dim_y] += dir[dim_y];
     }
   } else {
     /* PC is elsewhere.  Keep doing laps. */
-    dir[dim_x] = n->dir[dim_x];
-    dir[dim_y] = n->dir[dim_y];
-    if ((m->map[dest[dim_y] + dir[dim_y]]
-                    [dest[dim_x] + dir[dim_x]] != ter_water) ||
-        !((m->map[dest[dim_y] + dir[dim_y]]
-                 [dest[dim_x] + dir[dim_x]] == ter_path) &&
-          is_adjacent(((pair_t) { (int16_t) (dest[dim_x] + dir[dim_x]),
-                                  (int16_t) (dest[dim_y] + dir[dim_y]) }),
-                      ter_water))) {
-      rand_dir(dir);
-    }
+    rand_dir(dir);
 
-    if ((m->map[dest[dim_y] + dir[dim_y]]
-                    [dest[dim_x] + dir[dim_x]] == ter_water) ||
-        ((m->map[dest[dim_y] + dir[dim_y]]
-                [dest[dim_x] + dir[dim_x]] == ter_path) &&
-         is_adjacent(((pair_t) { (int16_t) (dest[dim_x] + dir[dim_x]),
-                                 (int16_t) (dest[dim_y] + dir[dim_y]) }),
-                     ter_water))) {
+    if (w->body[dest[dim_y] + dir[dim_y]][dest[dim_x] + dir[dim_x]]) {
       dest[dim_x] += dir[dim_x];
       dest[dim_y] += dir[dim_y];
     }
@@ -382,251 +283,3 @@ void (*move_func[num_movement_types])(character *, pair_t) = {
   move_swimmer_func,
   move_pc_func,
 };
-
-int32_t cmp_char_turns(const void *key, const void *with)
-{
-  return ((character *) key)->next_turn - ((character *) with)->next_turn;
-}
-
-void delete_character(void *v)
-{
-  if (v != &world.pc) {
-    delete((character *) v);
-  }
-}
-
-#define ter_cost(x, y, c) move_cost[c][m->map[y][x]]
-
-static int32_t hiker_cmp(const void *key, const void *with) {
-  return (world.hiker_dist[((path_t *) key)->pos[dim_y]]
-                          [((path_t *) key)->pos[dim_x]] -
-          world.hiker_dist[((path_t *) with)->pos[dim_y]]
-                          [((path_t *) with)->pos[dim_x]]);
-}
-
-static int32_t rival_cmp(const void *key, const void *with) {
-  return (world.rival_dist[((path_t *) key)->pos[dim_y]]
-                          [((path_t *) key)->pos[dim_x]] -
-          world.rival_dist[((path_t *) with)->pos[dim_y]]
-                          [((path_t *) with)->pos[dim_x]]);
-}
-
-void pathfind(map_t *m)
-{
-  heap_t h;
-  uint32_t x, y;
-  static path_t p[MAP_Y][MAP_X], *c;
-  static uint32_t initialized = 0;
-
-  if (!initialized) {
-    initialized = 1;
-    for (y = 0; y < MAP_Y; y++) {
-      for (x = 0; x < MAP_X; x++) {
-        p[y][x].pos[dim_y] = y;
-        p[y][x].pos[dim_x] = x;
-      }
-    }
-  }
-
-  for (y = 0; y < MAP_Y; y++) {
-    for (x = 0; x < MAP_X; x++) {
-      world.hiker_dist[y][x] = world.rival_dist[y][x] = INT_MAX;
-    }
-  }
-  world.hiker_dist[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = 
-    world.rival_dist[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = 0;
-
-  heap_init(&h, hiker_cmp, NULL);
-
-  for (y = 1; y < MAP_Y - 1; y++) {
-    for (x = 1; x < MAP_X - 1; x++) {
-      if (ter_cost(x, y, char_hiker) != INT_MAX) {
-        p[y][x].hn = heap_insert(&h, &p[y][x]);
-      } else {
-        p[y][x].hn = NULL;
-      }
-    }
-  }
-
-  while ((c = (path_t *) heap_remove_min(&h))) {
-    c->hn = NULL;
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn) &&
-        (world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn) &&
-        (world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn) &&
-        (world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] >
-         world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker))) {
-      world.hiker_dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] =
-        world.hiker_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_hiker);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn);
-    }
-  }
-  heap_delete(&h);
-
-  heap_init(&h, rival_cmp, NULL);
-
-  for (y = 1; y < MAP_Y - 1; y++) {
-    for (x = 1; x < MAP_X - 1; x++) {
-      if (ter_cost(x, y, char_rival) != INT_MAX) {
-        p[y][x].hn = heap_insert(&h, &p[y][x]);
-      } else {
-        p[y][x].hn = NULL;
-      }
-    }
-  }
-
-  while ((c = (path_t *) heap_remove_min(&h))) {
-    c->hn = NULL;
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn) &&
-        (world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x] - 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn) &&
-        (world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x]    ] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn) &&
-        (world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] - 1][c->pos[dim_x] + 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] - 1][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn) &&
-        (world.rival_dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y]    ][c->pos[dim_x] - 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn) &&
-        (world.rival_dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y]    ][c->pos[dim_x] + 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y]    ][c->pos[dim_x] + 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn) &&
-        (world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x] - 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] - 1].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn) &&
-        (world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x]    ] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x]    ].hn);
-    }
-    if ((p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn) &&
-        (world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] >
-         world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-         ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival))) {
-      world.rival_dist[c->pos[dim_y] + 1][c->pos[dim_x] + 1] =
-        world.rival_dist[c->pos[dim_y]][c->pos[dim_x]] +
-        ter_cost(c->pos[dim_x], c->pos[dim_y], char_rival);
-      heap_decrease_key_no_replace(&h,
-                                   p[c->pos[dim_y] + 1][c->pos[dim_x] + 1].hn);
-    }
-  }
-  heap_delete(&h);
-}
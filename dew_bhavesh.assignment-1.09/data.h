@@ -115,7 +115,12 @@ class WildPokemon {
     Moves chosen_fighting_move;
 };
 
-void determineGenderAndShiny(WildPokemon *p);
-void determinePokemonStats(WildPokemon *p, Pokemon pokemonTemp);
-void determinePokemonMoves(WildPokemon *p);
-void determinePokemonLevel(WildPokemon *p);
\ No newline at end of file
+/* seed selects a private rand_r() stream; NULL draws from rand(). */
+void determineGenderAndShiny(WildPokemon *p, unsigned int *seed = NULL);
+void determinePokemonStats(WildPokemon *p, Pokemon pokemonTemp,
+                           unsigned int *seed = NULL);
+void determinePokemonMoves(WildPokemon *p, unsigned int *seed = NULL);
+/* distance is the map's distance from the center of the world; a   *
+ * negative value uses the current map.                              */
+void determinePokemonLevel(WildPokemon *p, unsigned int *seed = NULL,
+                           int distance = -1);
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include <stdint.h>
+
+#include "diffuse.h"
+
+#define QUEUE_CAPACITY (MAP_X * MAP_Y)
+
+static void diffuse_push(diffuse_queue_t *q, int16_t x, int16_t y)
+{
+  uint32_t tail;
+
+  assert(q->size < QUEUE_CAPACITY);
+
+  tail = q->head + q->size;
+  if (tail >= QUEUE_CAPACITY) {
+    tail -= QUEUE_CAPACITY;
+  }
+  q->x[tail] = x;
+  q->y[tail] = y;
+  q->size++;
+}
+
+void diffuse_init(diffuse_queue_t *q)
+{
+  q->head = q->size = 0;
+}
+
+void diffuse_seed(diffuse_queue_t *q, uint8_t grid[MAP_Y][MAP_X],
+                  int16_t x, int16_t y, uint8_t value)
+{
+  grid[y][x] = value;
+  diffuse_push(q, x, y);
+}
+
+void diffuse(diffuse_queue_t *q, uint8_t grid[MAP_Y][MAP_X],
+             const diffuse_rule_t *rule)
+{
+  int16_t x, y, nx, ny;
+  uint8_t value;
+  uint32_t d;
+  int retried;
+
+  while (q->size) {
+    x = q->x[q->head];
+    y = q->y[q->head];
+    if (++q->head == QUEUE_CAPACITY) {
+      q->head = 0;
+    }
+    q->size--;
+    value = grid[y][x];
+    retried = 0;
+
+    for (d = 0; d < rule->num_dirs; d++) {
+      nx = x + rule->dirs[d][dim_x];
+      ny = y + rule->dirs[d][dim_y];
+
+      if (nx < 0 || nx >= MAP_X || ny < 0 || ny >= MAP_Y || grid[ny][nx]) {
+        continue;
+      }
+
+      if (!rule->accept || rule->accept(d)) {
+        grid[ny][nx] = value;
+        diffuse_push(q, nx, ny);
+      } else if (rule->retry_rejected && !retried) {
+        retried = 1;
+        diffuse_push(q, x, y);
+      }
+    }
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef DIFFUSE_H
+# define DIFFUSE_H
+
+# include <stdint.h>
+
+# include "poke327.h"
+
+/* Multi-source breadth-first diffusion over a MAP_Y x MAP_X byte grid.  *
+ * Zero cells are empty; every seeded value spreads into empty neighbors *
+ * until the rule stops it or the grid is full.  Each cell has at most   *
+ * one live entry at a time, so a MAP_X * MAP_Y ring never overflows and *
+ * a whole pass runs without allocating.                                 */
+typedef struct diffuse_queue {
+  uint32_t head, size;
+  uint8_t x[MAP_X * MAP_Y];
+  uint8_t y[MAP_X * MAP_Y];
+} diffuse_queue_t;
+
+/* Returns nonzero if a value may spread in direction d (an index into *
+ * the rule's dirs).  Only asked about in-bounds, empty neighbors.     */
+typedef int (*diffuse_accept_t)(uint32_t d);
+
+typedef struct diffuse_rule {
+  const pair_t *dirs;
+  uint32_t num_dirs;
+  diffuse_accept_t accept;  /* NULL accepts every empty neighbor        */
+  int retry_rejected;       /* Revisit a cell later, once per visit, if *
+                             * it failed to spread to an empty neighbor */
+} diffuse_rule_t;
+
+void diffuse_init(diffuse_queue_t *q);
+void diffuse_seed(diffuse_queue_t *q, uint8_t grid[MAP_Y][MAP_X],
+                  int16_t x, int16_t y, uint8_t value);
+void diffuse(diffuse_queue_t *q, uint8_t grid[MAP_Y][MAP_X],
+             const diffuse_rule_t *rule);
+
+#endif
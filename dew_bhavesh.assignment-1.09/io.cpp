@@ -8,6 +8,7 @@
 #include <algorithm>
 #include "io.h"
 #include "poke327.h"
+#include "route.h"
 #include "math.h"
 
 /*
@@ -121,8 +122,8 @@ static int compare_trainer_distance(const void *v1, const void *v2)
   const character *const *c1 = (const character * const *) v1;
   const character *const *c2 = (const character * const *) v2;
 
-  return (world.rival_dist[(*c1)->pos[dim_y]][(*c1)->pos[dim_x]] -
-          world.rival_dist[(*c2)->pos[dim_y]][(*c2)->pos[dim_x]]);
+  return (pathfind_dist(char_rival)[(*c1)->pos[dim_y]][(*c1)->pos[dim_x]] -
+          pathfind_dist(char_rival)[(*c2)->pos[dim_y]][(*c2)->pos[dim_x]]);
 }
 
 static character *io_nearest_visible_trainer()
@@ -254,13 +255,14 @@ uint32_t io_teleport_pc(pair_t dest)
 {
   /* Just for fun. And debugging.  Mostly debugging. */
 
+  pathfind(world.cur_map);
   do {
     dest[dim_x] = rand_range(1, MAP_X - 2);
     dest[dim_y] = rand_range(1, MAP_Y - 2);
   } while (world.cur_map->cmap[dest[dim_y]][dest[dim_x]]                  ||
            move_cost[char_pc][world.cur_map->map[dest[dim_y]]
                                                 [dest[dim_x]]] == INT_MAX ||
-           world.rival_dist[dest[dim_y]][dest[dim_x]] < 0);
+           pathfind_dist(char_rival)[dest[dim_y]][dest[dim_x]] == INT_MAX);
 
   return 0;
 }
@@ -352,7 +354,7 @@ static void io_list_trainers()
     for (x = 1; x < MAP_X - 1; x++) {
       if (world.cur_map->cmap[y][x] && world.cur_map->cmap[y][x] !=
           &world.pc) {
-        c[count++] = (npc *) world.cur_map->cmap[y][x];
+        c[count++] = (npc *) (character *) world.cur_map->cmap[y][x];
       }
     }
   }
@@ -896,25 +898,13 @@ void give_pc_pokemon()
     choice = getch();
   }
 }
-void give_npc_pokemon(character_t *c)
-{
-  WildPokemon p;
-  int index = rand() % 1093;
-
-  p.name = world.pokemon[index].identifier;
-  p.species_id = world.pokemon[index].species_id;
-  determinePokemonLevel(&p);
-  determinePokemonMoves(&p);
-  determinePokemonStats(&p, world.pokemon[index]);
-  determineGenderAndShiny(&p);
-  p.capturedStatus = npc_owned;
-  refresh();
-  (*c).pokemonTeam.push_back(p);
-}
-void determinePokemonLevel(WildPokemon *p)
+void determinePokemonLevel(WildPokemon *p, unsigned int *seed, int distance)
 {
   int minLevel, maxLevel;
-  int distance = abs(200 - world.cur_idx[dim_y]) + abs(200 - world.cur_idx[dim_x]);
+  if(distance < 0)
+  {
+    distance = abs(200 - world.cur_idx[dim_y]) + abs(200 - world.cur_idx[dim_x]);
+  }
   if(distance <= 200)
   {
     minLevel = 1;
@@ -933,11 +923,11 @@ void determinePokemonLevel(WildPokemon *p)
     }
     maxLevel = 100;
   }
-  int pokemonLevel = rand() % (maxLevel - minLevel + 1) + minLevel;
+  int pokemonLevel = pokemon_rand(seed) % (maxLevel - minLevel + 1) + minLevel;
   
   (*p).level = pokemonLevel;
 }
-void determinePokemonMoves(WildPokemon *p)
+void determinePokemonMoves(WildPokemon *p, unsigned int *seed)
 {
   int i;
   std::vector<PokemonMoves> possibleMoves;
@@ -950,8 +940,8 @@ void determinePokemonMoves(WildPokemon *p)
     }
   }
   //chooses random index from the list of possible moves to search for in moves
-  int randomIndex1 = rand() % possibleMoves.size();
-  int randomIndex2 = rand() % possibleMoves.size();
+  int randomIndex1 = pokemon_rand(seed) % possibleMoves.size();
+  int randomIndex2 = pokemon_rand(seed) % possibleMoves.size();
   std::vector<Moves> returnMoves;
   length = sizeof(world.moves) / sizeof(Moves);
   for(i = 0; i < length; i++)
@@ -968,7 +958,8 @@ void determinePokemonMoves(WildPokemon *p)
   p->learnedMoves[0] = returnMoves.at(0);
   p->learnedMoves[1] = returnMoves.at(1);
 }
-void determinePokemonStats(WildPokemon *p, Pokemon pokemonTemp)
+void determinePokemonStats(WildPokemon *p, Pokemon pokemonTemp,
+                           unsigned int *seed)
 {
   std::vector<int> baseStats;
   int i;
@@ -980,22 +971,22 @@ void determinePokemonStats(WildPokemon *p, Pokemon pokemonTemp)
       baseStats.push_back(world.pokeStats[i].base_stat);
     }
   }
-  int IV = rand() % 16;
+  int IV = pokemon_rand(seed) % 16;
   int HP = floor((((baseStats.at(0) + IV) * 2) * (p->level))/100) + p->level + 10;
 
-  IV = rand() % 16;
+  IV = pokemon_rand(seed) % 16;
   int att = floor((((baseStats.at(1) + IV) * 2) * (p->level))/100) + 5;
 
-  IV = rand() % 16;
+  IV = pokemon_rand(seed) % 16;
   int def = floor((((baseStats.at(2) + IV) * 2) * (p->level))/100) + 5;
 
-  IV = rand() % 16;
+  IV = pokemon_rand(seed) % 16;
   int specialAtt= floor((((baseStats.at(3) + IV) * 2) * (p->level))/100) + 5;
 
-  IV = rand() % 16;
+  IV = pokemon_rand(seed) % 16;
   int specialDef = floor((((baseStats.at(4) + IV) * 2) * (p->level))/100) + 5;
 
-  IV = rand() % 16;
+  IV = pokemon_rand(seed) % 16;
   int speed = floor((((baseStats.at(5) + IV) * 2) * (p->level))/100) + 5;
 
   // IV = rand() % 16;
@@ -1014,10 +1005,10 @@ void determinePokemonStats(WildPokemon *p, Pokemon pokemonTemp)
   // (*p).accuracy = accuracy;
   // (*p).evasion = evasion;
 }
-void determineGenderAndShiny(WildPokemon *p)
+void determineGenderAndShiny(WildPokemon *p, unsigned int *seed)
 {
   std::string genderString;
-  int gender = rand() % 2;
+  int gender = pokemon_rand(seed) % 2;
   if(gender == 0)
   {
     (*p).gender = "male";
@@ -1026,7 +1017,7 @@ void determineGenderAndShiny(WildPokemon *p)
   {
     (*p).gender = "female";
   }
-  int shinyRate = rand() % 8192;
+  int shinyRate = pokemon_rand(seed) % 8192;
   if(shinyRate == 0)
   {
     (*p).shiny = true;
@@ -1411,6 +1402,8 @@ void io_pokemonEncounter()
 }
 uint32_t move_pc_dir(uint32_t input, pair_t dest)
 {
+  character *occupant;
+
   dest[dim_y] = world.pc.pos[dim_y];
   dest[dim_x] = world.pc.pos[dim_x];
 
@@ -1457,14 +1450,12 @@ uint32_t move_pc_dir(uint32_t input, pair_t dest)
     break;
   }
 
-  if (world.cur_map->cmap[dest[dim_y]][dest[dim_x]]) {
-    if (dynamic_cast<npc *>(world.cur_map->cmap[dest[dim_y]][dest[dim_x]]) &&
-        ((npc *) world.cur_map->cmap[dest[dim_y]][dest[dim_x]])->defeated) {
+  if ((occupant = world.cur_map->cmap[dest[dim_y]][dest[dim_x]])) {
+    if (dynamic_cast<npc *>(occupant) && ((npc *) occupant)->defeated) {
       // Some kind of greeting here would be nice
       return 1;
-    } else if (dynamic_cast<npc *>
-               (world.cur_map->cmap[dest[dim_y]][dest[dim_x]])) {
-      io_battle(&world.pc, world.cur_map->cmap[dest[dim_y]][dest[dim_x]]);
+    } else if (dynamic_cast<npc *>(occupant)) {
+      io_battle(&world.pc, occupant);
       // Not actually moving, so set dest back to PC position
       dest[dim_x] = world.pc.pos[dim_x];
       dest[dim_y] = world.pc.pos[dim_y];
@@ -1527,6 +1518,95 @@ void io_teleport_world(pair_t dest)
   io_teleport_pc(dest);
 }
 
+/* The route being walked, if any, and how far along it the PC is */
+static std::vector<route_leg_t> travel;
+static uint32_t travel_leg;
+
+/* Plans a walk to a map of the player's choosing.  The walk itself is *
+ * taken by io_travel_step(), a step a turn.                           */
+static void io_travel()
+{
+  int x = INT_MAX, y = INT_MAX;
+  pair_t to;
+  int32_t cost;
+
+  echo();
+  curs_set(1);
+  do {
+    mvprintw(0, 0, "Travel to x [-200, 200]:       ");
+    refresh();
+    mvscanw(0, 25, "%d", &x);
+  } while (x < -200 || x > 200);
+  do {
+    mvprintw(0, 0, "Travel to y [-200, 200]:       ");
+    refresh();
+    mvscanw(0, 25, "%d", &y);
+  } while (y < -200 || y > 200);
+
+  refresh();
+  noecho();
+  curs_set(0);
+
+  to[dim_x] = x + 200;
+  to[dim_y] = y + 200;
+  travel_leg = 0;
+  if ((cost = route_plan(world.cur_map, world.pc.pos, to, travel)) < 0) {
+    io_queue_message("There's no way to (%d, %d) from here.", x, y);
+  } else if (!cost) {
+    io_queue_message("You're already there.");
+  } else {
+    io_queue_message("Traveling to (%d, %d), %u maps away.  "
+                     "Any key stops.", x, y, (uint32_t) travel.size());
+  }
+}
+
+/* Takes the PC's next step along the route, if it's traveling; returns *
+ * 0 if it isn't, or if the route has ended.  A key pressed stops it.   */
+static uint32_t io_travel_step(pair_t dest)
+{
+  uint32_t dir;
+
+  if (travel_leg < travel.size() &&
+      (world.cur_idx[dim_x] != travel[travel_leg].idx[dim_x] ||
+       world.cur_idx[dim_y] != travel[travel_leg].idx[dim_y])) {
+    travel_leg++;
+  }
+  if (travel_leg >= travel.size()) {
+    if (!travel.empty()) {
+      travel.clear();
+      io_queue_message("You've arrived.");
+      io_display();
+    }
+    return 0;
+  }
+
+  nodelay(stdscr, TRUE);
+  if (getch() != ERR ||
+      world.cur_idx[dim_x] != travel[travel_leg].idx[dim_x] ||
+      world.cur_idx[dim_y] != travel[travel_leg].idx[dim_y] ||
+      route_step(world.cur_map, world.pc.pos, travel[travel_leg].exit,
+                 dest)) {
+    nodelay(stdscr, FALSE);
+    travel.clear();
+    io_queue_message("You stop traveling.");
+    io_display();
+    return 0;
+  }
+  nodelay(stdscr, FALSE);
+  usleep(TRAVEL_STEP_US);
+
+  /* As a key on the number pad: 7 8 9 above, 1 2 3 below */
+  dir = ((dest[dim_y] - world.pc.pos[dim_y] + 1) * -3 + 7 +
+         (dest[dim_x] - world.pc.pos[dim_x] + 1));
+  if (move_pc_dir(dir, dest)) {
+    /* A defeated trainer is in the way; wait for it to move */
+    dest[dim_x] = world.pc.pos[dim_x];
+    dest[dim_y] = world.pc.pos[dim_y];
+  }
+
+  return 1;
+}
+
 void bag_potion()
 {
   WINDOW * pokeWin = newwin(getmaxy(stdscr), getmaxx(stdscr),0, 0);
@@ -1613,6 +1693,9 @@ void io_handle_input(pair_t dest)
   int key;
   WINDOW * bagWin;
   do {
+    if (io_travel_step(dest)) {
+      break;
+    }
     switch (key = getch()) {
     case 'B' :
       bagWin = newwin(getmaxy(stdscr), getmaxx(stdscr),0, 0);
@@ -1719,6 +1802,12 @@ void io_handle_input(pair_t dest)
       io_teleport_world(dest);
       turn_not_consumed = 0;
       break;
+    case 'g':
+      /* Go to any map in the world, on foot.                        */
+      io_travel();
+      io_display();
+      turn_not_consumed = 1;
+      break;
     case 'q':
       /* Demonstrate use of the message queue.  You can use this for *
        * printf()-style debugging (though gdb is probably a better   *
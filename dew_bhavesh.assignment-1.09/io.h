@@ -12,5 +12,4 @@ void io_handle_input(pair_t dest);
 void io_queue_message(const char *format, ...);
 void io_battle(character_t *aggressor, character_t *defender);
 void give_pc_pokemon();
-void give_npc_pokemon(character_t *c);
 #endif
@@ -0,0 +1,369 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "mapcache.h"
+#include "mapgen.h"
+
+typedef struct map_cold {
+  map_record_t *record;
+  uint32_t pc_team_size;
+  struct map_cold *lru_prev, *lru_next;
+} map_cold_t;
+
+/* Every map ever cached, in the order first visited, with whichever  *
+ * tier holds it now, if either does.  Maps are found by an open       *
+ * addressing (linear probing) hash table of positions in visited,     *
+ * keyed by packed coordinates.  Entries are never removed, so the     *
+ * table needs no tombstones; it doubles whenever it is half full.     */
+typedef struct map_slot {
+  uint32_t key;
+  map_t *hot;
+  map_cold_t *cold;
+} map_slot_t;
+
+#define INDEX_MIN_BITS 10
+
+static size_t budget;
+static map_cache_stats_t stats;
+static std::vector<map_slot_t> visited;
+static uint32_t *index_table;  /* Position in visited + 1, or 0 if empty */
+static uint32_t index_bits;
+
+/* Most recently used at the head */
+static map_t *hot_head, *hot_tail;
+static map_cold_t *cold_head, *cold_tail;
+
+static void hot_unlink(map_t *m)
+{
+  if (m->lru_prev) {
+    m->lru_prev->lru_next = m->lru_next;
+  } else {
+    hot_head = m->lru_next;
+  }
+  if (m->lru_next) {
+    m->lru_next->lru_prev = m->lru_prev;
+  } else {
+    hot_tail = m->lru_prev;
+  }
+}
+
+static void hot_push(map_t *m)
+{
+  m->lru_prev = NULL;
+  m->lru_next = hot_head;
+  if (hot_head) {
+    hot_head->lru_prev = m;
+  } else {
+    hot_tail = m;
+  }
+  hot_head = m;
+}
+
+static void cold_unlink(map_cold_t *c)
+{
+  if (c->lru_prev) {
+    c->lru_prev->lru_next = c->lru_next;
+  } else {
+    cold_head = c->lru_next;
+  }
+  if (c->lru_next) {
+    c->lru_next->lru_prev = c->lru_prev;
+  } else {
+    cold_tail = c->lru_prev;
+  }
+}
+
+static void cold_push(map_cold_t *c)
+{
+  c->lru_prev = NULL;
+  c->lru_next = cold_head;
+  if (cold_head) {
+    cold_head->lru_prev = c;
+  } else {
+    cold_tail = c;
+  }
+  cold_head = c;
+}
+
+static uint32_t index_key(pair_t idx)
+{
+  return ((uint32_t) (uint16_t) idx[dim_y] << 16) | (uint16_t) idx[dim_x];
+}
+
+static uint32_t index_hash(uint32_t key)
+{
+  return (key * 0x9e3779b1) >> (32 - index_bits);
+}
+
+static void index_grow()
+{
+  uint32_t i, h, mask;
+
+  free(index_table);
+  index_bits = index_bits ? index_bits + 1 : INDEX_MIN_BITS;
+  index_table = (uint32_t *) calloc(1 << index_bits, sizeof (*index_table));
+  mask = (1 << index_bits) - 1;
+
+  for (i = 0; i < visited.size(); i++) {
+    for (h = index_hash(visited[i].key); index_table[h]; h = (h + 1) & mask)
+      ;
+    index_table[h] = i + 1;
+  }
+}
+
+/* The slot for idx, added if add is set, otherwise NULL if idx has  *
+ * never been cached.  Only valid until the next slot is added.      */
+static map_slot_t *find_slot(pair_t idx, int add)
+{
+  uint32_t key, h, i;
+  map_slot_t s;
+
+  if (!index_table) {
+    if (!add) {
+      return NULL;
+    }
+    index_grow();
+  }
+
+  key = index_key(idx);
+  for (h = index_hash(key); (i = index_table[h]);
+       h = (h + 1) & ((1 << index_bits) - 1)) {
+    if (visited[i - 1].key == key) {
+      return &visited[i - 1];
+    }
+  }
+
+  if (!add) {
+    return NULL;
+  }
+
+  s.key = key;
+  s.hot = NULL;
+  s.cold = NULL;
+  visited.push_back(s);
+  index_table[h] = visited.size();
+  stats.visited_maps++;
+  if (visited.size() * 2 > (size_t) 1 << index_bits) {
+    index_grow();
+  }
+
+  return &visited.back();
+}
+
+static uint32_t hot_size(map_t *m)
+{
+  uint32_t size, k;
+  character *c;
+
+  size = (sizeof (*m) + m->cmap.capacity() * sizeof (character *) +
+          m->dist_bytes);
+  for (k = 0; k < m->cmap.size(); k++) {
+    if ((c = m->cmap.at(k)) != &world.pc) {
+      size += (sizeof (npc) +
+               c->pokemonTeam.capacity() * sizeof (WildPokemon));
+    }
+  }
+
+  return size;
+}
+
+/* Distance maps are only cached on the current map, so its size is the *
+ * only one that changes, and is counted again as it's left.            */
+static void hot_resize(map_t *m)
+{
+  map_slot_t *s;
+
+  if (!m || !(s = find_slot(m->idx, 0)) || s->hot != m) {
+    return;
+  }
+
+  stats.hot_bytes -= m->cache_bytes;
+  m->cache_bytes = hot_size(m);
+  stats.hot_bytes += m->cache_bytes;
+}
+
+static size_t cold_size(map_cold_t *c)
+{
+  return sizeof (*c) + map_record_size(c->record);
+}
+
+static map_t *cold_thaw(map_cold_t *c)
+{
+  std::vector<npc *> trainers;
+  map_t *m;
+
+  m = map_thaw(c->record, trainers);
+  m->pc_team_size = c->pc_team_size;
+  generate_npc_teams(trainers, map_distance(m->idx), m->pc_team_size);
+
+  return m;
+}
+
+static void cold_free(map_cold_t *c)
+{
+  free(c->record);
+  free(c);
+}
+
+static void hot_add(map_t *m)
+{
+  find_slot(m->idx, 1)->hot = m;
+  hot_push(m);
+  m->cache_bytes = hot_size(m);
+  stats.hot_bytes += m->cache_bytes;
+  stats.hot_maps++;
+}
+
+static void demote(map_t *m)
+{
+  map_slot_t *s;
+  map_cold_t *c;
+
+  s = find_slot(m->idx, 0);
+  hot_unlink(m);
+  s->hot = NULL;
+  stats.hot_bytes -= m->cache_bytes;
+  stats.hot_maps--;
+
+  c = (map_cold_t *) malloc(sizeof (*c));
+  c->record = map_freeze(m);
+  c->pc_team_size = m->pc_team_size;
+  s->cold = c;
+  cold_push(c);
+  stats.cold_bytes += cold_size(c);
+  stats.cold_maps++;
+  stats.demotions++;
+
+  map_delete(m);
+}
+
+static void cold_remove(map_cold_t *c)
+{
+  cold_unlink(c);
+  find_slot(c->record->idx, 0)->cold = NULL;
+  stats.cold_bytes -= cold_size(c);
+  stats.cold_maps--;
+}
+
+static void map_cache_trim()
+{
+  map_t *m;
+  map_cold_t *c;
+
+  /* Never the current map, nor the one just used, which is about to be */
+  while (stats.hot_bytes > budget / 2) {
+    for (m = hot_tail;
+         m && (m == world.cur_map || m == hot_head);
+         m = m->lru_prev)
+      ;
+    if (!m) {
+      break;
+    }
+    demote(m);
+  }
+
+  while (stats.hot_bytes + stats.cold_bytes > budget && (c = cold_tail)) {
+    cold_remove(c);
+    cold_free(c);
+    stats.evictions++;
+  }
+}
+
+void map_cache_init(size_t budget_kb)
+{
+  budget = budget_kb * 1024;
+}
+
+map_t *map_cache_get(pair_t idx)
+{
+  map_slot_t *s;
+  map_cold_t *c;
+  map_t *m;
+
+  /* Still the map being left */
+  hot_resize(world.cur_map);
+
+  s = find_slot(idx, 0);
+  if (s && (m = s->hot)) {
+    hot_unlink(m);
+    hot_push(m);
+    stats.hits++;
+    map_cache_trim();
+
+    return m;
+  }
+
+  if (!s || !(c = s->cold)) {
+    stats.misses++;
+
+    return NULL;
+  }
+
+  cold_remove(c);
+  m = cold_thaw(c);
+  cold_free(c);
+  hot_add(m);
+  stats.cold_faults++;
+  map_cache_trim();
+
+  return m;
+}
+
+int map_cache_contains(pair_t idx)
+{
+  map_slot_t *s;
+
+  return (s = find_slot(idx, 0)) && (s->hot || s->cold);
+}
+
+map_t *map_cache_peek(pair_t idx)
+{
+  map_slot_t *s;
+
+  return (s = find_slot(idx, 0)) ? s->hot : NULL;
+}
+
+void map_cache_insert(map_t *m)
+{
+  hot_add(m);
+  map_cache_trim();
+}
+
+void map_cache_clear()
+{
+  map_t *m;
+  map_cold_t *c;
+  uint32_t i;
+
+  /* Only maps ever visited, not the whole world */
+  for (i = 0; i < visited.size(); i++) {
+    if ((m = visited[i].hot)) {
+      hot_unlink(m);
+      stats.hot_bytes -= m->cache_bytes;
+      stats.hot_maps--;
+      map_delete(m);
+    }
+    if ((c = visited[i].cold)) {
+      cold_unlink(c);
+      stats.cold_bytes -= cold_size(c);
+      stats.cold_maps--;
+      cold_free(c);
+    }
+  }
+
+  visited.clear();
+  stats.visited_maps = 0;
+  free(index_table);
+  index_table = NULL;
+  index_bits = 0;
+}
+
+const map_cache_stats_t *map_cache_stats()
+{
+  hot_resize(world.cur_map);
+
+  return &stats;
+}
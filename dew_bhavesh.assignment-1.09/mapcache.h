@@ -0,0 +1,46 @@
+#ifndef MAPCACHE_H
+# define MAPCACHE_H
+
+# include <stdint.h>
+# include <stddef.h>
+
+# include "poke327.h"
+
+/* Visited maps live in two tiers under a memory budget, found through *
+ * a hash table of only the maps visited, so its cost doesn't grow     *
+ * with the size of the world.  Recently visited maps are hot: whole   *
+ * map_ts, counted with the distance maps pathfind() caches on them.   *
+ * Once the hot tier outgrows half of the budget, its least recently   *
+ * used maps are demoted to the cold tier, which keeps only run-length *
+ * encoded terrain and each trainer's state.  Teams are rebuilt from   *
+ * their seeds and height, which is only used while generating, is not *
+ * kept.  Once both tiers together outgrow the budget, the least       *
+ * recently used cold maps are dropped entirely; maps are a function   *
+ * of the world seed and their coordinates, so they are simply         *
+ * regenerated if visited again, with their trainers back at full      *
+ * strength.  The current map is never demoted.                        */
+
+typedef struct map_cache_stats {
+  uint32_t visited_maps;  /* Ever cached, whether or not they still are */
+  uint32_t hot_maps, cold_maps;
+  size_t hot_bytes, cold_bytes;
+  uint64_t hits;         /* Found hot                      */
+  uint64_t cold_faults;  /* Found cold and thawed          */
+  uint64_t misses;       /* Not cached, must be generated  */
+  uint64_t demotions;    /* Moved from hot to cold         */
+  uint64_t evictions;    /* Dropped from cold              */
+} map_cache_stats_t;
+
+void map_cache_init(size_t budget_kb);
+/* Returns the map at idx, thawing it if it is cold, or NULL if it has *
+ * to be generated.  Either way, counts as a use of idx.               */
+map_t *map_cache_get(pair_t idx);
+int map_cache_contains(pair_t idx);
+/* The map at idx if it is hot, or NULL; doesn't count as a use */
+map_t *map_cache_peek(pair_t idx);
+/* Takes ownership of a freshly generated map (with m->idx set). */
+void map_cache_insert(map_t *m);
+void map_cache_clear();
+const map_cache_stats_t *map_cache_stats();
+
+#endif
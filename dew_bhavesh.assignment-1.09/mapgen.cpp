@@ -0,0 +1,1456 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+
+#include <vector>
+
+#include "heap.h"
+#include "poke327.h"
+#include "diffuse.h"
+#include "mapgen.h"
+
+/* Map generation draws from its own per-thread stream, so a map can be *
+ * built on a worker thread without touching rand()'s global state.     */
+static thread_local unsigned int mapgen_seed;
+#define mapgen_rand() rand_r(&mapgen_seed)
+
+const char *mapgen_phase_name[num_mapgen_phases] = {
+  "smooth_height",
+  "map_terrain",
+  "place_boulders",
+  "place_trees",
+  "build_paths",
+  "place_buildings",
+  "pathfind",
+  "place_characters",
+};
+
+static thread_local mapgen_profile_t *profile;
+
+void mapgen_set_profile(mapgen_profile_t *p)
+{
+  profile = p;
+}
+
+static uint64_t profile_ns()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t profile_allocations()
+{
+  return profile->allocations ? profile->allocations() : 0;
+}
+
+/* Runs stmt, charging it to phase if a profile is set */
+#define profiled(phase, stmt) {                                 \
+  uint64_t _ns, _allocs;                                        \
+                                                                \
+  if (profile) {                                                \
+    _allocs = profile_allocations();                            \
+    _ns = profile_ns();                                         \
+    stmt;                                                       \
+    profile->ns[phase] += profile_ns() - _ns;                   \
+    profile->allocs[phase] += profile_allocations() - _allocs;  \
+  } else {                                                      \
+    stmt;                                                       \
+  }                                                             \
+}
+
+const char *terrain_mode_name[num_terrain_modes] = {
+  "diffuse",
+  "voronoi",
+};
+
+/* Shared by every thread, so only set before generating */
+static terrain_mode_t terrain_mode;
+static uint32_t smooth_passes = HEIGHT_SMOOTH_PASSES;
+
+void mapgen_set_terrain_mode(terrain_mode_t t)
+{
+  terrain_mode = t;
+}
+
+terrain_mode_t mapgen_terrain_mode()
+{
+  return terrain_mode;
+}
+
+void mapgen_set_smooth_passes(uint32_t passes)
+{
+  assert(passes);
+
+  smooth_passes = passes;
+}
+
+uint32_t mapgen_smooth_passes()
+{
+  return smooth_passes;
+}
+
+int terrain_mode_parse(const char *name)
+{
+  int t;
+
+  for (t = 0; t < num_terrain_modes; t++) {
+    if (!strcmp(name, terrain_mode_name[t])) {
+      return t;
+    }
+  }
+
+  return -1;
+}
+
+pair_t all_dirs[8] = {
+  { -1, -1 },
+  { -1,  0 },
+  { -1,  1 },
+  {  0, -1 },
+  {  0,  1 },
+  {  1, -1 },
+  {  1,  0 },
+  {  1,  1 },
+};
+
+static int32_t edge_penalty(int8_t x, int8_t y)
+{
+  return (x == 1 || y == 1 || x == MAP_X - 2 || y == MAP_Y - 2) ? 2 : 1;
+}
+
+/* Road costs only ever grow along a path, so the router's open set is a *
+ * radix heap: bucket i holds the keys that first differ from the last   *
+ * key removed in bit i - 1, bucket 0 those equal to it.  Removing the   *
+ * minimum only redistributes one bucket into the ones below it.  Cells  *
+ * are pushed again rather than decreased in place; stale entries are    *
+ * skipped when they surface.  Each cell is pushed at most once per      *
+ * neighbor, so entries come from a fixed pool and buckets are lists.    */
+#define ROAD_HEAP_ENTRIES (4 * MAP_X * MAP_Y + 1)
+
+typedef struct road_entry {
+  uint32_t key;
+  uint16_t cell;
+  uint16_t next;
+} road_entry_t;
+
+typedef struct road_heap {
+  road_entry_t entry[ROAD_HEAP_ENTRIES + 1]; /* Entry 0 ends every list */
+  uint16_t bucket[33];
+  uint16_t used;
+  uint32_t last;
+} road_heap_t;
+
+static inline uint32_t road_bucket(road_heap_t *h, uint32_t key)
+{
+  return key == h->last ? 0 : 32 - __builtin_clz(key ^ h->last);
+}
+
+static inline void road_link(road_heap_t *h, uint16_t e)
+{
+  uint32_t b = road_bucket(h, h->entry[e].key);
+
+  h->entry[e].next = h->bucket[b];
+  h->bucket[b] = e;
+}
+
+static void road_init(road_heap_t *h)
+{
+  memset(h->bucket, 0, sizeof (h->bucket));
+  h->used = 0;
+  h->last = 0;
+}
+
+static inline void road_push(road_heap_t *h, uint32_t key, uint16_t cell)
+{
+  uint16_t e = ++h->used;
+
+  h->entry[e].key = key;
+  h->entry[e].cell = cell;
+  road_link(h, e);
+}
+
+/* Returns the entry with the smallest key, or NULL if there are none */
+static road_entry_t *road_pop(road_heap_t *h)
+{
+  uint16_t e, next;
+  uint32_t i;
+
+  if (!h->bucket[0]) {
+    for (i = 1; i < 33 && !h->bucket[i]; i++)
+      ;
+    if (i == 33) {
+      return NULL;
+    }
+    for (h->last = UINT32_MAX, e = h->bucket[i]; e; e = h->entry[e].next) {
+      if (h->entry[e].key < h->last) {
+        h->last = h->entry[e].key;
+      }
+    }
+    for (e = h->bucket[i], h->bucket[i] = 0; e; e = next) {
+      next = h->entry[e].next;
+      road_link(h, e);
+    }
+  }
+
+  e = h->bucket[0];
+  h->bucket[0] = h->entry[e].next;
+
+  return &h->entry[e];
+}
+
+/* A* from one gate to another.  A step costs the height of the cell     *
+ * being left, and entering a cell next to the border doubles the total, *
+ * so every step adds at least the lowest height on the map; that times  *
+ * the Manhattan distance to go is the heuristic.  Roads already laid    *
+ * count, at height 0, so once there is one the heuristic is 0 and this  *
+ * is Dijkstra.  Per-cell state is valid only if its stamp is this       *
+ * call's epoch, so nothing is cleared between calls, and nothing is     *
+ * allocated.                                                            */
+uint32_t astar_path(mapgen_t *m, pair_t from, pair_t to)
+{
+  static thread_local uint32_t cost[MAP_Y][MAP_X];
+  static thread_local uint8_t dir[MAP_Y][MAP_X];
+  static thread_local uint32_t stamp[MAP_Y][MAP_X];
+  static thread_local uint32_t epoch;
+  static thread_local road_heap_t h;
+  static const int8_t road_dirs[4][2] = {
+    { -1,  0 }, {  0, -1 }, {  0,  1 }, {  1,  0 }
+  };
+  uint32_t seen, done, min_height, g, i;
+  int32_t x, y, nx, ny;
+  road_entry_t *e;
+
+  /* stamp is seen + 1 once a cell is done */
+  if ((epoch += 2) < 2) {
+    memset(stamp, 0, sizeof (stamp));
+    epoch = 2;
+  }
+  seen = epoch;
+  done = epoch + 1;
+
+  min_height = UINT8_MAX;
+  for (y = 1; y < MAP_Y - 1 && min_height; y++) {
+    for (x = 1; x < MAP_X - 1; x++) {
+      if (heightxy(x, y) < min_height) {
+        min_height = heightxy(x, y);
+      }
+    }
+  }
+
+#define road_h(x, y) \
+  (min_height * (abs((x) - to[dim_x]) + abs((y) - to[dim_y])))
+
+  road_init(&h);
+
+  cost[from[dim_y]][from[dim_x]] = 0;
+  stamp[from[dim_y]][from[dim_x]] = seen;
+  road_push(&h, road_h(from[dim_x], from[dim_y]),
+            from[dim_y] * MAP_X + from[dim_x]);
+
+  while ((e = road_pop(&h))) {
+    y = e->cell / MAP_X;
+    x = e->cell % MAP_X;
+    if (stamp[y][x] == done || e->key != cost[y][x] + road_h(x, y)) {
+      continue;
+    }
+    stamp[y][x] = done;
+
+    if (x == to[dim_x] && y == to[dim_y]) {
+      g = cost[y][x];
+      while (x != from[dim_x] || y != from[dim_y]) {
+        mapxy(x, y) = ter_path;
+        heightxy(x, y) = 0;
+        i = dir[y][x];
+        x -= road_dirs[i][1];
+        y -= road_dirs[i][0];
+      }
+      return g;
+    }
+
+    for (i = 0; i < 4; i++) {
+      ny = y + road_dirs[i][0];
+      nx = x + road_dirs[i][1];
+      if (!ny || !nx || ny == MAP_Y - 1 || nx == MAP_X - 1 ||
+          stamp[ny][nx] == done) {
+        continue;
+      }
+      g = (cost[y][x] + heightxy(x, y)) * edge_penalty(nx, ny);
+      if (stamp[ny][nx] != seen || g < cost[ny][nx]) {
+        cost[ny][nx] = g;
+        dir[ny][nx] = i;
+        stamp[ny][nx] = seen;
+        road_push(&h, g + road_h(nx, ny), ny * MAP_X + nx);
+      }
+    }
+  }
+#undef road_h
+
+  return UINT32_MAX;
+}
+
+static int build_paths(mapgen_t *m, road_router_t route)
+{
+  pair_t from, to;
+
+  /*  printf("%d %d %d %d\n", m->n, m->s, m->e, m->w);*/
+
+  if (m->e != -1 && m->w != -1) {
+    from[dim_x] = 1;
+    to[dim_x] = MAP_X - 2;
+    from[dim_y] = m->w;
+    to[dim_y] = m->e;
+
+    route(m, from, to);
+  }
+
+  if (m->n != -1 && m->s != -1) {
+    from[dim_y] = 1;
+    to[dim_y] = MAP_Y - 2;
+    from[dim_x] = m->n;
+    to[dim_x] = m->s;
+
+    route(m, from, to);
+  }
+
+  if (m->e == -1) {
+    if (m->s == -1) {
+      from[dim_x] = 1;
+      from[dim_y] = m->w;
+      to[dim_x] = m->n;
+      to[dim_y] = 1;
+    } else {
+      from[dim_x] = 1;
+      from[dim_y] = m->w;
+      to[dim_x] = m->s;
+      to[dim_y] = MAP_Y - 2;
+    }
+
+    route(m, from, to);
+  }
+
+  if (m->w == -1) {
+    if (m->s == -1) {
+      from[dim_x] = MAP_X - 2;
+      from[dim_y] = m->e;
+      to[dim_x] = m->n;
+      to[dim_y] = 1;
+    } else {
+      from[dim_x] = MAP_X - 2;
+      from[dim_y] = m->e;
+      to[dim_x] = m->s;
+      to[dim_y] = MAP_Y - 2;
+    }
+
+    route(m, from, to);
+  }
+
+  if (m->n == -1) {
+    if (m->e == -1) {
+      from[dim_x] = 1;
+      from[dim_y] = m->w;
+      to[dim_x] = m->s;
+      to[dim_y] = MAP_Y - 2;
+    } else {
+      from[dim_x] = MAP_X - 2;
+      from[dim_y] = m->e;
+      to[dim_x] = m->s;
+      to[dim_y] = MAP_Y - 2;
+    }
+
+    route(m, from, to);
+  }
+
+  if (m->s == -1) {
+    if (m->e == -1) {
+      from[dim_x] = 1;
+      from[dim_y] = m->w;
+      to[dim_x] = m->n;
+      to[dim_y] = 1;
+    } else {
+      from[dim_x] = MAP_X - 2;
+      from[dim_y] = m->e;
+      to[dim_x] = m->n;
+      to[dim_y] = 1;
+    }
+
+    route(m, from, to);
+  }
+
+  return 0;
+}
+
+/* Heights flood every empty neighbor, including diagonals. */
+static const diffuse_rule_t height_diffusion = {
+  all_dirs, 8, NULL, 0
+};
+
+/* Terrain regions only grow orthogonally, and favor spreading east and *
+ * west (80%) over north and south (20%) so regions come out wide.  A   *
+ * region that fails a roll gets one more turn later.                   */
+static const pair_t terrain_dirs[4] = {
+  { -1,  0 },
+  {  0, -1 },
+  {  0,  1 },
+  {  1,  0 },
+};
+
+static int terrain_accept(uint32_t d)
+{
+  return (mapgen_rand() % 100) < (terrain_dirs[d][dim_x] ? 80 : 20);
+}
+
+static const diffuse_rule_t terrain_diffusion = {
+  terrain_dirs, 4, terrain_accept, 1
+};
+
+/* The height map is smoothed with the 5-tap binomial kernel 1 4 6 4 1, *
+ * applied across rows and then down columns, which is the same as one  *
+ * pass of the separable 5x5 Gaussian.  Rows are zero padded so the     *
+ * inner loops need no bounds checks; the edges are renormalized by the *
+ * weight of the taps that were in bounds.  Sums stay within 16 bits    *
+ * (255 * 16 * 16 = 65280), so eight cells are done per vector op.      */
+typedef uint16_t height_vec_t __attribute__ ((vector_size (16)));
+
+#define HEIGHT_LANES (sizeof (height_vec_t) / sizeof (uint16_t))
+
+static_assert(!(MAP_X % HEIGHT_LANES), "MAP_X must fill whole vectors");
+
+static inline height_vec_t load_height_vec(const uint16_t *p)
+{
+  height_vec_t v;
+
+  memcpy(&v, p, sizeof (v));
+
+  return v;
+}
+
+static inline height_vec_t binomial5(height_vec_t a, height_vec_t b,
+                                     height_vec_t c, height_vec_t d,
+                                     height_vec_t e)
+{
+  return a + e + ((b + d) << 2) + (c << 2) + (c << 1);
+}
+
+/* Total in-bounds kernel weight at each index along a dimension. */
+static void binomial5_weights(uint32_t *w, int32_t n)
+{
+  static const uint32_t k[5] = { 1, 4, 6, 4, 1 };
+  int32_t i, j;
+
+  for (i = 0; i < n; i++) {
+    for (w[i] = 0, j = -2; j <= 2; j++) {
+      if (i + j >= 0 && i + j < n) {
+        w[i] += k[j + 2];
+      }
+    }
+  }
+}
+
+static void gaussian_pass(uint8_t in[MAP_Y][MAP_X], uint8_t out[MAP_Y][MAP_X])
+{
+  static thread_local uint32_t wx[MAP_X], wy[MAP_Y];
+  static thread_local uint32_t initialized = 0;
+  uint16_t row[MAP_X + 4];
+  uint16_t h[MAP_Y + 4][MAP_X];
+  height_vec_t v;
+  uint32_t i, d;
+  int32_t x, y;
+
+  if (!initialized) {
+    binomial5_weights(wx, MAP_X);
+    binomial5_weights(wy, MAP_Y);
+    initialized = 1;
+  }
+
+  /* Across rows, into h with two zero rows above and below */
+  memset(h, 0, sizeof (h));
+  row[0] = row[1] = row[MAP_X + 2] = row[MAP_X + 3] = 0;
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      row[x + 2] = in[y][x];
+    }
+    for (x = 0; x < MAP_X; x += HEIGHT_LANES) {
+      v = binomial5(load_height_vec(row + x),
+                    load_height_vec(row + x + 1),
+                    load_height_vec(row + x + 2),
+                    load_height_vec(row + x + 3),
+                    load_height_vec(row + x + 4));
+      memcpy(&h[y + 2][x], &v, sizeof (v));
+    }
+  }
+
+  /* Down columns, then divide out the kernel weight */
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x += HEIGHT_LANES) {
+      v = binomial5(load_height_vec(&h[y    ][x]),
+                    load_height_vec(&h[y + 1][x]),
+                    load_height_vec(&h[y + 2][x]),
+                    load_height_vec(&h[y + 3][x]),
+                    load_height_vec(&h[y + 4][x]));
+      for (i = 0; i < HEIGHT_LANES; i++) {
+        d = wx[x + i] * wy[y];
+        out[y][x + i] = (v[i] + d / 2) / d;
+      }
+    }
+  }
+}
+
+static int smooth_height(mapgen_t *m)
+{
+  int32_t i, x, y;
+  diffuse_queue_t queue;
+  /*  FILE *out;*/
+  uint8_t height[MAP_Y][MAP_X];
+
+  memset(&height, 0, sizeof (height));
+  diffuse_init(&queue);
+
+  /* Seed with some values */
+  for (i = 1; i < 255; i += 20) {
+    do {
+      x = mapgen_rand() % MAP_X;
+      y = mapgen_rand() % MAP_Y;
+    } while (height[y][x]);
+    diffuse_seed(&queue, height, x, y, i);
+  }
+
+  /*
+  out = fopen("seeded.pgm", "w");
+  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
+  fwrite(&height, sizeof (height), 1, out);
+  fclose(out);
+  */
+  
+  /* Diffuse the vaules to fill the space */
+  diffuse(&queue, height, &height_diffusion);
+
+  /* And smooth it a bit with a gaussian convolution.  Each pass *
+   * smooths the previous one, until it's smooth like Kenny G.    */
+  gaussian_pass(height, m->height);
+  for (i = 1; i < (int32_t) smooth_passes; i++) {
+    memcpy(height, m->height, sizeof (height));
+    gaussian_pass(height, m->height);
+  }
+
+  /*
+  out = fopen("diffused.pgm", "w");
+  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
+  fwrite(&height, sizeof (height), 1, out);
+  fclose(out);
+
+  out = fopen("smoothed.pgm", "w");
+  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
+  fwrite(&m->height, sizeof (m->height), 1, out);
+  fclose(out);
+  */
+
+  return 0;
+}
+
+/* One bit per cell of a row */
+typedef unsigned __int128 row_mask_t;
+
+static_assert(MAP_X <= 128, "A row must fit in a row_mask_t");
+
+static inline uint32_t row_mask_count(row_mask_t r)
+{
+  return (__builtin_popcountll((uint64_t) r) +
+          __builtin_popcountll((uint64_t) (r >> 64)));
+}
+
+/* A building's northwest corner may go where its 2x2 footprint is clear *
+ * of roads and buildings and two cells of road run along one side.  All *
+ * such corners are found at once, a row of cells to a bitwise operation, *
+ * and one is picked uniformly.  Returns -1, leaving p alone, if the map  *
+ * has none.                                                              */
+static int find_building_location(mapgen_t *m, pair_t p)
+{
+  row_mask_t path[MAP_Y], blocked[MAP_Y], valid[MAP_Y], foot, r;
+  const row_mask_t corners =
+    (((row_mask_t) 1 << (MAP_X - 3)) - 1) << 1; /* x in [1, MAP_X - 3] */
+  uint32_t count, k;
+  int x, y;
+
+  for (y = 0; y < MAP_Y; y++) {
+    path[y] = blocked[y] = 0;
+    for (x = 0; x < MAP_X; x++) {
+      path[y] |= (row_mask_t) (mapxy(x, y) == ter_path) << x;
+      blocked[y] |= (row_mask_t) (mapxy(x, y) == ter_path   ||
+                                  mapxy(x, y) == ter_mart   ||
+                                  mapxy(x, y) == ter_center) << x;
+    }
+  }
+
+  for (count = 0, y = 0; y < MAP_Y; y++) {
+    valid[y] = 0;
+    if (y < 1 || y > MAP_Y - 3) {
+      continue;
+    }
+    r = path[y] & path[y + 1];
+    foot = blocked[y] | blocked[y + 1];
+    valid[y] = ((r << 1) |                                 /* West  */
+                (r >> 2) |                                 /* East  */
+                (path[y - 1] & (path[y - 1] >> 1)) |       /* North */
+                (path[y + 2] & (path[y + 2] >> 1)));       /* South */
+    valid[y] &= ~(foot | (foot >> 1)) & corners;
+    count += row_mask_count(valid[y]);
+  }
+
+  if (!count) {
+    return -1;
+  }
+
+  k = mapgen_rand() % count;
+  for (y = 0; k >= row_mask_count(valid[y]); y++) {
+    k -= row_mask_count(valid[y]);
+  }
+  for (r = valid[y]; k; k--) {
+    r &= r - 1;
+  }
+  p[dim_x] = ((uint64_t) r ? __builtin_ctzll((uint64_t) r) :
+              64 + __builtin_ctzll((uint64_t) (r >> 64)));
+  p[dim_y] = y;
+
+  return 0;
+}
+
+static int place_pokemart(mapgen_t *m)
+{
+  pair_t p;
+
+  if (find_building_location(m, p)) {
+    return -1;
+  }
+
+  mapxy(p[dim_x]    , p[dim_y]    ) = ter_mart;
+  mapxy(p[dim_x] + 1, p[dim_y]    ) = ter_mart;
+  mapxy(p[dim_x]    , p[dim_y] + 1) = ter_mart;
+  mapxy(p[dim_x] + 1, p[dim_y] + 1) = ter_mart;
+
+  return 0;
+}
+
+static int place_center(mapgen_t *m)
+{  pair_t p;
+
+  if (find_building_location(m, p)) {
+    return -1;
+  }
+
+  mapxy(p[dim_x]    , p[dim_y]    ) = ter_center;
+  mapxy(p[dim_x] + 1, p[dim_y]    ) = ter_center;
+  mapxy(p[dim_x]    , p[dim_y] + 1) = ter_center;
+  mapxy(p[dim_x] + 1, p[dim_y] + 1) = ter_center;
+
+  return 0;
+}
+
+/* Regions as a jittered Voronoi diagram: every cell takes the type of   *
+ * its nearest seed.  Distances are taken from each cell's position      *
+ * nudged by up to half a cell either way, which roughens region         *
+ * borders, and vertical distance counts double, since diffusion spreads *
+ * east and west four times as readily as north and south.  A whole      *
+ * vector of a row's cells is measured against a seed at a time.         */
+typedef int16_t terrain_vec_t __attribute__ ((vector_size (16)));
+
+#define TERRAIN_LANES (sizeof (terrain_vec_t) / sizeof (int16_t))
+
+static_assert(!(MAP_X % TERRAIN_LANES), "MAP_X must fill whole vectors");
+
+static void voronoi_terrain(mapgen_t *m, pair_t *seeds,
+                            terrain_type_t *types, int32_t num_seeds)
+{
+  int16_t px[MAP_Y][MAP_X], py[MAP_Y][MAP_X], out[TERRAIN_LANES];
+  terrain_vec_t cx, cy, dx, dy, d, best, type;
+  uint32_t bits, num_bits, i, x, y;
+
+  /* Two bits of jitter per axis per cell, eight cells to a draw */
+  for (num_bits = bits = y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      if (num_bits < 4) {
+        bits = mapgen_rand();
+        num_bits = 30;
+      }
+      px[y][x] = 2 * x + ((bits & 3) == 3) - !(bits & 3);
+      py[y][x] = 2 * (2 * y + ((bits & 12) == 12) - !(bits & 12));
+      bits >>= 4;
+      num_bits -= 4;
+    }
+  }
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x += TERRAIN_LANES) {
+      memcpy(&cx, &px[y][x], sizeof (cx));
+      memcpy(&cy, &py[y][x], sizeof (cy));
+      best = cx - cx + (int16_t) INT16_MAX;
+      type = cx - cx;
+      for (i = 0; i < (uint32_t) num_seeds; i++) {
+        dx = cx - (int16_t) (2 * seeds[i][dim_x]);
+        dy = cy - (int16_t) (4 * seeds[i][dim_y]);
+        d = dx * dx + dy * dy;
+        type = d < best ? (int16_t) types[i] + (type - type) : type;
+        best = d < best ? d : best;
+      }
+      memcpy(out, &type, sizeof (out));
+      for (i = 0; i < TERRAIN_LANES; i++) {
+        mapxy(x + i, y) = (terrain_type_t) out[i];
+      }
+    }
+  }
+}
+
+static int map_terrain(mapgen_t *m, int8_t n, int8_t s, int8_t e, int8_t w)
+{
+  int32_t i, x, y;
+  diffuse_queue_t queue;
+  //  FILE *out;
+  int num_grass, num_clearing, num_mountain, num_forest,num_water, num_total;
+  terrain_type_t type;
+  pair_t seeds[5 + 5 + 2 + 2 + 2];
+  terrain_type_t types[5 + 5 + 2 + 2 + 2];
+  
+  num_grass = mapgen_rand() % 4 + 2;
+  num_clearing = mapgen_rand() % 4 + 2;
+  num_mountain = mapgen_rand() % 2 + 1;
+  num_forest = mapgen_rand() % 2 + 1;
+   num_water = mapgen_rand() % 2 + 1;
+  num_total = num_grass + num_clearing + num_mountain + num_forest +num_water;
+
+  memset(&m->map, 0, sizeof (m->map));
+
+  /* Seed with some values */
+  for (i = 0; i < num_total; i++) {
+    do {
+      x = mapgen_rand() % MAP_X;
+      y = mapgen_rand() % MAP_Y;
+    } while (m->map[y][x]);
+    if (i == 0) {
+      type = ter_grass;
+    } else if (i == num_grass) {
+      type = ter_clearing;
+    } else if (i == num_grass + num_clearing) {
+      type = ter_mountain;
+    } else if (i == num_grass + num_clearing + num_mountain) {
+      type = ter_forest;
+    } else if (i == num_grass + num_clearing + num_mountain + num_forest) {
+      type = ter_water;
+    }
+    mapxy(x, y) = types[i] = type;
+    seeds[i][dim_x] = x;
+    seeds[i][dim_y] = y;
+  }
+
+  /*
+  out = fopen("seeded.pgm", "w");
+  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
+  fwrite(&m->map, sizeof (m->map), 1, out);
+  fclose(out);
+  */
+
+  if (terrain_mode == terrain_voronoi) {
+    voronoi_terrain(m, seeds, types, num_total);
+  } else {
+    diffuse_init(&queue);
+    for (i = 0; i < num_total; i++) {
+      diffuse_seed(&queue, (uint8_t (*)[MAP_X]) m->map,
+                   seeds[i][dim_x], seeds[i][dim_y], types[i]);
+    }
+    /* Diffuse the vaules to fill the space */
+    diffuse(&queue, (uint8_t (*)[MAP_X]) m->map, &terrain_diffusion);
+  }
+
+  /*
+  out = fopen("diffused.pgm", "w");
+  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
+  fwrite(&m->map, sizeof (m->map), 1, out);
+  fclose(out);
+  */
+  
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      if (y == 0 || y == MAP_Y - 1 ||
+          x == 0 || x == MAP_X - 1) {
+        mapxy(x, y) = ter_boulder;
+      }
+    }
+  }
+
+  m->n = n;
+  m->s = s;
+  m->e = e;
+  m->w = w;
+
+  if (n != -1) {
+    mapxy(n,         0        ) = ter_exit;
+    mapxy(n,         1        ) = ter_path;
+  }
+  if (s != -1) {
+    mapxy(s,         MAP_Y - 1) = ter_exit;
+    mapxy(s,         MAP_Y - 2) = ter_path;
+  }
+  if (w != -1) {
+    mapxy(0,         w        ) = ter_exit;
+    mapxy(1,         w        ) = ter_path;
+  }
+  if (e != -1) {
+    mapxy(MAP_X - 1, e        ) = ter_exit;
+    mapxy(MAP_X - 2, e        ) = ter_path;
+  }
+
+  return 0;
+}
+
+static int place_boulders(mapgen_t *m)
+{
+  int i;
+  int x, y;
+
+  for (i = 0; i < MIN_BOULDERS || mapgen_rand() % 100 < BOULDER_PROB; i++) {
+    y = mapgen_rand() % (MAP_Y - 2) + 1;
+    x = mapgen_rand() % (MAP_X - 2) + 1;
+    if (m->map[y][x] != ter_forest && m->map[y][x] != ter_path) {
+      m->map[y][x] = ter_boulder;
+    }
+  }
+
+  return 0;
+}
+
+static int place_trees(mapgen_t *m)
+{
+  int i;
+  int x, y;
+  
+  for (i = 0; i < MIN_TREES || mapgen_rand() % 100 < TREE_PROB; i++) {
+    y = mapgen_rand() % (MAP_Y - 2) + 1;
+    x = mapgen_rand() % (MAP_X - 2) + 1;
+    if (m->map[y][x] != ter_mountain && m->map[y][x] != ter_path &&
+        m->map[y][x] != ter_water) {
+      m->map[y][x] = ter_tree;
+    }
+  }
+
+  return 0;
+}
+
+void rand_pos(pair_t pos)
+{
+  pos[dim_x] = (mapgen_rand() % (MAP_X - 2)) + 1;
+  pos[dim_y] = (mapgen_rand() % (MAP_Y - 2)) + 1;
+}
+
+static npc *new_hiker(map_t *m, const int hiker_dist[MAP_Y][MAP_X])
+{
+  pair_t pos;
+  npc *c;
+
+  do {
+    rand_pos(pos);
+  } while (hiker_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
+           m->cmap[pos[dim_y]][pos[dim_x]]               ||
+           pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4      ||
+           pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
+
+  m->cmap[pos[dim_y]][pos[dim_x]] = c = new npc;
+  c->pos[dim_y] = pos[dim_y];
+  c->pos[dim_x] = pos[dim_x];
+  c->ctype = char_hiker;
+  c->mtype = move_hiker;
+  c->dir[dim_x] = 0;
+  c->dir[dim_y] = 0;
+  c->defeated = 0;
+  c->symbol = 'h';
+  c->next_turn = 0;
+
+  heap_insert(&m->turn, c);
+  m->cmap[pos[dim_y]][pos[dim_x]] = c;
+
+  //  printf("Hiker at %d,%d\n", pos[dim_x], pos[dim_y]);
+
+  return c;
+}
+
+static npc *new_rival(map_t *m, const int rival_dist[MAP_Y][MAP_X])
+{
+  pair_t pos;
+  npc *c;
+
+  do {
+    rand_pos(pos);
+  } while (rival_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
+           rival_dist[pos[dim_y]][pos[dim_x]] < 0        ||
+           m->cmap[pos[dim_y]][pos[dim_x]]               ||
+           pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4      ||
+           pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
+
+  m->cmap[pos[dim_y]][pos[dim_x]] = c = new npc;
+  c->pos[dim_y] = pos[dim_y];
+  c->pos[dim_x] = pos[dim_x];
+  c->ctype = char_rival;
+  c->mtype = move_rival;
+  c->dir[dim_x] = 0;
+  c->dir[dim_y] = 0;
+  c->defeated = 0;
+  c->symbol = 'r';
+  c->next_turn = 0;
+
+  heap_insert(&m->turn, c);
+  m->cmap[pos[dim_y]][pos[dim_x]] = c;
+
+  return c;
+}
+
+void new_swimmer(map_t *m)
+{
+  pair_t pos;
+  npc *c;
+   
+  do {
+    rand_pos(pos);
+  } while (m->map[pos[dim_y]][pos[dim_x]] != ter_water ||
+           m->cmap[pos[dim_y]][pos[dim_x]]);
+
+  m->cmap[pos[dim_y]][pos[dim_x]] = c = new npc;
+  c->pos[dim_y] = pos[dim_y];
+  c->pos[dim_x] = pos[dim_x];
+  c->ctype = char_swimmer;
+  c->mtype = move_swim;
+  c->dir[dim_x] = 0;
+  c->dir[dim_y] = 0;
+  c->defeated = 0;
+  c->symbol = 's';
+  c->next_turn = 0;
+  heap_insert(&m->turn, c);
+  m->cmap[pos[dim_y]][pos[dim_x]] = c;
+}
+
+static npc *new_char_other(map_t *m, const int other_dist[MAP_Y][MAP_X])
+{
+  pair_t pos;
+  npc *c;
+  int d;
+
+  do {
+    rand_pos(pos);
+  } while (other_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
+           other_dist[pos[dim_y]][pos[dim_x]] < 0        ||
+           m->cmap[pos[dim_y]][pos[dim_x]]               ||
+           pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4      ||
+           pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
+
+  m->cmap[pos[dim_y]][pos[dim_x]] = c = new npc;
+  c->pos[dim_y] = pos[dim_y];
+  c->pos[dim_x] = pos[dim_x];
+  c->ctype = char_other;
+  switch (mapgen_rand() % 4) {
+  case 0:
+    c->mtype = move_pace;
+    c->symbol = 'p';
+    break;
+  case 1:
+    c->mtype = move_wander;
+    c->symbol = 'w';
+    break;
+  case 2:
+    c->mtype = move_sentry;
+    c->symbol = 's';
+    break;
+  case 3:
+    c->mtype = move_walk;
+    c->symbol = 'n';
+    break;
+  }
+  /* rand_dir(), but from the map generation stream */
+  d = mapgen_rand() & 0x7;
+  c->dir[dim_x] = all_dirs[d][dim_x];
+  c->dir[dim_y] = all_dirs[d][dim_y];
+  c->defeated = 0;
+  c->next_turn = 0;
+
+  heap_insert(&m->turn, c);
+  m->cmap[pos[dim_y]][pos[dim_x]] = c;
+
+  return c;
+}
+
+/* Manhattan distance of a map from the center of the world */
+int map_distance(pair_t idx)
+{
+  return (abs(idx[dim_x] - (WORLD_SIZE / 2)) +
+          abs(idx[dim_y] - (WORLD_SIZE / 2)));
+}
+
+/* Only touches m and the distance maps passed in, so this may run on *
+ * a thread other than the game's for a map that isn't current yet.    */
+static void place_characters(map_t *m, dist_maps_t *dist,
+                             std::vector<npc *> &trainers)
+{
+  size_t i;
+
+  m->num_trainers = 2;
+
+  //Always place a hiker and a rival, then place a random number of others
+  trainers.push_back(new_hiker(m, dist->of[char_hiker]));
+  trainers.push_back(new_rival(m, dist->of[char_rival]));
+  do {
+    //higher probability of non- hikers and rivals
+    switch(mapgen_rand() % 10) {
+    case 0:
+      trainers.push_back(new_hiker(m, dist->of[char_hiker]));
+      break;
+    case 1:
+      trainers.push_back(new_rival(m, dist->of[char_rival]));
+      break;
+    default:
+      trainers.push_back(new_char_other(m, dist->of[char_rival]));
+      break;
+    }
+    /* Game attempts to continue to place trainers until the probability *
+     * roll fails, but if the map is full (or almost full), it's         *
+     * impossible (or very difficult) to continue to add, so we abort if *
+     * we've tried MAX_TRAINER_TRIES times.                              */
+  } while (++m->num_trainers < MIN_TRAINERS ||
+           ((mapgen_rand() % 100) < ADD_TRAINER_PROB));
+
+  for (i = 0; i < trainers.size(); i++) {
+    trainers[i]->team_seed = mapgen_rand();
+  }
+}
+
+/* A map is a pure function of the world seed and its coordinates, so   *
+ * maps can be built in any order, on any thread, and rebuilt later      *
+ * exactly as they were.  Each map draws from a stream seeded by a hash  *
+ * of its coordinates, and each gate is hashed from the edge it sits on, *
+ * so the maps on either side agree without looking at each other.       */
+typedef enum world_hash_tag {
+  hash_map,
+  hash_gate_ns,  /* Edge between (x, y - 1) and (x, y) */
+  hash_gate_ew   /* Edge between (x - 1, y) and (x, y) */
+} world_hash_tag_t;
+
+static uint32_t mix32(uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x7feb352d;
+  h ^= h >> 15;
+  h *= 0x846ca68b;
+  h ^= h >> 16;
+
+  return h;
+}
+
+static uint32_t world_hash(world_hash_tag_t tag, int16_t x, int16_t y)
+{
+  return mix32(world.seed ^ mix32((tag << 18) ^ (y << 9) ^ x));
+}
+
+static void map_gates(pair_t idx, int *n, int *s, int *e, int *w)
+{
+  int16_t x = idx[dim_x], y = idx[dim_y];
+
+  *n = y ? 3 + world_hash(hash_gate_ns, x, y) % (MAP_X - 6) : -1;
+  *s = (y < WORLD_SIZE - 1 ?
+        3 + world_hash(hash_gate_ns, x, y + 1) % (MAP_X - 6) : -1);
+  *w = x ? 3 + world_hash(hash_gate_ew, x, y) % (MAP_Y - 6) : -1;
+  *e = (x < WORLD_SIZE - 1 ?
+        3 + world_hash(hash_gate_ew, x + 1, y) % (MAP_Y - 6) : -1);
+}
+
+/* Everything before the roads */
+static void generate_roadless(mapgen_t *g, pair_t idx)
+{
+  int n, s, e, w;
+
+  map_gates(idx, &n, &s, &e, &w);
+  profiled(phase_smooth_height, smooth_height(g));
+  profiled(phase_map_terrain, map_terrain(g, n, s, e, w));
+
+  profiled(phase_place_boulders, place_boulders(g));
+  profiled(phase_place_trees, place_trees(g));
+}
+
+static uint16_t water_root(uint16_t *parent, uint16_t c)
+{
+  while (parent[c] != c) {
+    c = parent[c] = parent[parent[c]];
+  }
+
+  return c;
+}
+
+static inline uint32_t row_mask_ctz(row_mask_t r)
+{
+  return ((uint64_t) r ? __builtin_ctzll((uint64_t) r) :
+          64 + __builtin_ctzll((uint64_t) (r >> 64)));
+}
+
+/* Labels m's bodies of water.  The shore, and the cells a swimmer can  *
+ * be on, are found a row at a time by bitwise operations; then one     *
+ * pass over those cells joins each with the ones already passed, by    *
+ * union-find, and one more numbers the bodies.                         */
+static void label_water(map_t *m)
+{
+  const row_mask_t interior = (((row_mask_t) 1 << (MAP_X - 2)) - 1) << 1;
+  uint16_t (*body)[MAP_X] = m->water.body;
+  uint16_t parent[MAP_Y * MAP_X], id[MAP_Y * MAP_X];
+  row_mask_t water[MAP_Y], path[MAP_Y], swim[MAP_Y], shore, v, r;
+  uint16_t next, c, n, p;
+  uint8_t b;
+  int x, y, i;
+
+#define swim_at(x, y) ((swim[y] >> (x)) & 1)
+
+  /* Two cells to a packed byte, low nibble first */
+  for (y = 0; y < MAP_Y; y++) {
+    water[y] = path[y] = swim[y] = 0;
+    for (x = 0; x < MAP_X; x += 2) {
+      b = m->map.cells[y][x >> 1];
+      water[y] |= (((row_mask_t) ((b & 0xf) == ter_water) << x) |
+                   ((row_mask_t) ((b >> 4) == ter_water) << (x + 1)));
+      path[y] |= (((row_mask_t) ((b & 0xf) == ter_path) << x) |
+                  ((row_mask_t) ((b >> 4) == ter_path) << (x + 1)));
+    }
+  }
+
+  memset(&m->water, 0, sizeof (m->water));
+  memset(id, 0, sizeof (id));
+  for (y = 1; y < MAP_Y - 1; y++) {
+    v = water[y - 1] | water[y + 1];
+    shore = (v | v << 1 | v >> 1 | water[y] << 1 | water[y] >> 1) & interior;
+    swim[y] = (water[y] | (path[y] & shore)) & interior;
+    for (i = 0; i < (MAP_X + 7) / 8; i++) {
+      m->water.shore[y][i] = shore >> (i * 8);
+    }
+
+    /* A cell joins its west and north neighbors' body outright.  The  *
+     * north is already joined with the northwest and northeast, and    *
+     * the west with the northwest and north, so only the northeast,    *
+     * or, with neither, the northwest and northeast, may be elsewhere. */
+    for (r = swim[y]; r; r &= r - 1) {
+      x = row_mask_ctz(r);
+      c = y * MAP_X + x;
+      if (swim_at(x - 1, y)) {
+        parent[c] = c - 1;
+        if (swim_at(x, y - 1) || !swim_at(x + 1, y - 1)) {
+          continue;
+        }
+      } else if (swim_at(x, y - 1)) {
+        parent[c] = c - MAP_X;
+        continue;
+      } else {
+        parent[c] = c;
+        if (swim_at(x - 1, y - 1)) {
+          parent[water_root(parent, c - MAP_X - 1)] = c;
+        }
+        if (!swim_at(x + 1, y - 1)) {
+          continue;
+        }
+      }
+      n = water_root(parent, c - MAP_X + 1);
+      if (n != (p = water_root(parent, c))) {
+        parent[n] = p;
+      }
+    }
+  }
+
+  for (y = 1, next = 0; y < MAP_Y - 1; y++) {
+    for (r = swim[y]; r; r &= r - 1) {
+      x = row_mask_ctz(r);
+      if (!id[c = water_root(parent, y * MAP_X + x)]) {
+        id[c] = ++next;
+      }
+      body[y][x] = id[c];
+    }
+  }
+#undef swim_at
+}
+
+/* Builds everything but the characters.  Randomness comes from the  *
+ * calling thread's mapgen stream, so this is safe off the game thread. */
+static void generate_terrain(map_t *m, pair_t idx)
+{
+  mapgen_t g;
+  int d, p;
+  int x, y;
+
+  generate_roadless(&g, idx);
+  profiled(phase_build_paths, build_paths(&g, astar_path));
+  d = map_distance(idx);
+  p = d > 200 ? 5 : (50 - ((45 * d) / 200));
+  //  printf("d=%d, p=%d\n", d, p);
+  if ((mapgen_rand() % 100) < p || !d) {
+    profiled(phase_place_buildings, place_pokemart(&g));
+  }
+  if ((mapgen_rand() % 100) < p || !d) {
+    profiled(phase_place_buildings, place_center(&g));
+  }
+
+  for (y = 0; y < MAP_Y; y++) {
+    for (x = 0; x < MAP_X; x++) {
+      m->map[y][x] = g.map[y][x];
+    }
+  }
+  m->n = g.n;
+  m->s = g.s;
+  m->e = g.e;
+  m->w = g.w;
+
+  label_water(m);
+
+  m->cmap.reset();
+  heap_init(&m->turn, cmp_char_turns, delete_character);
+  m->pc_team_size = 0;
+  m->dist_cache = NULL;
+  m->dist_bytes = 0;
+}
+
+int32_t cmp_char_turns(const void *key, const void *with)
+{
+  return ((character *) key)->next_turn - ((character *) with)->next_turn;
+}
+
+void delete_character(void *v)
+{
+  if (v != &world.pc) {
+    delete((character *) v);
+  }
+}
+
+void occupancy::reset()
+{
+  memset(bits, 0, sizeof (bits));
+  chars = NULL;
+  num = cap = 0;
+}
+
+void occupancy::release()
+{
+  free(chars);
+  reset();
+}
+
+void occupancy::set(int i, character *c)
+{
+  uint64_t bit = 1ULL << (i & 63);
+  uint32_t k = rank(i);
+
+  if (bits[i >> 6] & bit) {
+    if (c) {
+      chars[k] = c;
+    } else {
+      memmove(chars + k, chars + k + 1, (num - k - 1) * sizeof (*chars));
+      num--;
+      bits[i >> 6] &= ~bit;
+    }
+  } else if (c) {
+    if (num == cap) {
+      cap = cap ? cap * 2 : 16;
+      chars = (character **) realloc(chars, cap * sizeof (*chars));
+    }
+    memmove(chars + k + 1, chars + k, (num - k) * sizeof (*chars));
+    chars[k] = c;
+    num++;
+    bits[i >> 6] |= bit;
+  }
+}
+
+/* Frees a map along with the characters on its turn queue */
+void map_delete(map_t *m)
+{
+  dist_cache_free(m);
+  heap_delete(&m->turn);
+  m->cmap.release();
+  free(m);
+}
+
+/* A map built with no PC to place against, as pokegen builds them, *
+ * places its trainers against the map's first road cell.  Roads join *
+ * every gate, so that reaches everywhere the PC can arrive.          */
+static void map_anchor(map_t *m, pair_t anchor)
+{
+  int x, y;
+
+  for (y = 1; y < MAP_Y - 1; y++) {
+    for (x = 1; x < MAP_X - 1; x++) {
+      if (m->map[y][x] == ter_path) {
+        anchor[dim_x] = x;
+        anchor[dim_y] = y;
+        return;
+      }
+    }
+  }
+  anchor[dim_x] = MAP_X / 2;
+  anchor[dim_y] = MAP_Y / 2;
+}
+
+static void place_trainers(map_t *m, pair_t anchor, dist_maps_t *dist,
+                           std::vector<npc *> &trainers)
+{
+  profiled(phase_pathfind, pathfind_from(m, anchor, dist));
+  profiled(phase_place_characters, place_characters(m, dist, trainers));
+}
+
+void generate_map(map_t *m, pair_t idx, dist_maps_t *dist,
+                  std::vector<npc *> &trainers)
+{
+  pair_t anchor;
+
+  generate_map_terrain(m, idx);
+  map_anchor(m, anchor);
+  place_trainers(m, anchor, dist, trainers);
+}
+
+void generate_map_terrain(map_t *m, pair_t idx)
+{
+  mapgen_seed = world_hash(hash_map, idx[dim_x], idx[dim_y]);
+  m->idx[dim_x] = idx[dim_x];
+  m->idx[dim_y] = idx[dim_y];
+  generate_terrain(m, idx);
+}
+
+void generate_map_characters(map_t *m, pair_t pc, dist_maps_t *dist,
+                             std::vector<npc *> &trainers)
+{
+  int reserve = !m->cmap[pc[dim_y]][pc[dim_x]];
+
+  /* Keep trainers off the cell the PC is on or will arrive on */
+  if (reserve) {
+    m->cmap[pc[dim_y]][pc[dim_x]] = &world.pc;
+  }
+  place_trainers(m, pc, dist, trainers);
+  if (reserve) {
+    m->cmap[pc[dim_y]][pc[dim_x]] = NULL;
+  }
+}
+
+void generate_map_roadless(mapgen_t *g, pair_t idx)
+{
+  mapgen_seed = world_hash(hash_map, idx[dim_x], idx[dim_y]);
+  generate_roadless(g, idx);
+}
+
+void generate_roads(mapgen_t *g, road_router_t route)
+{
+  build_paths(g, route);
+}
+
+static record_char_t *record_chars(const map_record_t *r)
+{
+  return (record_char_t *) (r + 1);
+}
+
+static uint8_t *record_terrain(const map_record_t *r)
+{
+  return (uint8_t *) (record_chars(r) + r->num_chars);
+}
+
+size_t map_record_size(const map_record_t *r)
+{
+  return sizeof (*r) + r->num_chars * sizeof (record_char_t) + r->terrain_len;
+}
+
+map_record_t *map_freeze(map_t *m)
+{
+  uint8_t runs[MAP_X * MAP_Y * 2];
+  std::vector<record_char_t> chars;
+  record_char_t t;
+  map_record_t *r;
+  terrain_type_t ter;
+  uint32_t i, len;
+  npc *n;
+
+  /* Runs may wrap rows */
+  for (i = len = 0; i < MAP_X * MAP_Y; i++) {
+    ter = m->map[i / MAP_X][i % MAP_X];
+    if (len && runs[len - 1] == ter && runs[len - 2] < UINT8_MAX) {
+      runs[len - 2]++;
+    } else {
+      runs[len++] = 1;
+      runs[len++] = ter;
+    }
+  }
+
+  for (i = 0; i < m->cmap.size(); i++) {
+    if ((n = dynamic_cast<npc *>(m->cmap.at(i)))) {
+      t.pos[dim_x] = n->pos[dim_x];
+      t.pos[dim_y] = n->pos[dim_y];
+      t.dir[dim_x] = n->dir[dim_x];
+      t.dir[dim_y] = n->dir[dim_y];
+      t.next_turn = n->next_turn;
+      t.team_seed = n->team_seed;
+      t.ctype = n->ctype;
+      t.mtype = n->mtype;
+      t.defeated = n->defeated;
+      t.symbol = n->symbol;
+      chars.push_back(t);
+    }
+  }
+
+  r = (map_record_t *) malloc(sizeof (*r) + chars.size() * sizeof (t) + len);
+  r->idx[dim_x] = m->idx[dim_x];
+  r->idx[dim_y] = m->idx[dim_y];
+  r->n = m->n;
+  r->s = m->s;
+  r->e = m->e;
+  r->w = m->w;
+  r->num_trainers = m->num_trainers;
+  r->terrain_len = len;
+  r->num_chars = chars.size();
+  memcpy(record_chars(r), chars.data(), chars.size() * sizeof (t));
+  memcpy(record_terrain(r), runs, len);
+
+  return r;
+}
+
+map_t *map_thaw(const map_record_t *r, std::vector<npc *> &trainers)
+{
+  const record_char_t *c = record_chars(r);
+  const uint8_t *terrain = record_terrain(r);
+  map_t *m;
+  uint32_t i, j, k;
+  npc *n;
+
+  m = (map_t *) malloc(sizeof (*m));
+  for (i = k = 0; i < r->terrain_len; i += 2) {
+    for (j = 0; j < terrain[i]; j++, k++) {
+      m->map[k / MAP_X][k % MAP_X] = (terrain_type_t) terrain[i + 1];
+    }
+  }
+  m->cmap.reset();
+  heap_init(&m->turn, cmp_char_turns, delete_character);
+  m->dist_cache = NULL;
+  m->dist_bytes = 0;
+  m->idx[dim_x] = r->idx[dim_x];
+  m->idx[dim_y] = r->idx[dim_y];
+  m->n = r->n;
+  m->s = r->s;
+  m->e = r->e;
+  m->w = r->w;
+  m->num_trainers = r->num_trainers;
+  m->pc_team_size = 0;
+  label_water(m);
+
+  for (i = 0; i < r->num_chars; i++) {
+    n = new npc;
+    n->pos[dim_x] = c[i].pos[dim_x];
+    n->pos[dim_y] = c[i].pos[dim_y];
+    n->dir[dim_x] = c[i].dir[dim_x];
+    n->dir[dim_y] = c[i].dir[dim_y];
+    n->next_turn = c[i].next_turn;
+    n->team_seed = c[i].team_seed;
+    n->ctype = c[i].ctype;
+    n->mtype = c[i].mtype;
+    n->defeated = c[i].defeated;
+    n->symbol = c[i].symbol;
+    m->cmap[n->pos[dim_y]][n->pos[dim_x]] = n;
+    heap_insert(&m->turn, n);
+    trainers.push_back(n);
+  }
+
+  return m;
+}
@@ -0,0 +1,132 @@
+#ifndef MAPGEN_H
+# define MAPGEN_H
+
+# include <stdint.h>
+# include <stddef.h>
+
+# include <vector>
+
+# include "poke327.h"
+
+/* Map generation touches nothing but the map being built, the distance  *
+ * maps passed in and world.seed, so it runs on any thread, and without  *
+ * the rest of the game (or ncurses) linked in.                          */
+
+/* Builds the whole map at idx into m, which the caller has malloc()ed.  *
+ * The distance maps are scratch space.  The trainers placed are added   *
+ * to trainers, with empty teams; generate_npc_teams() fills them in.    */
+void generate_map(map_t *m, pair_t idx, dist_maps_t *dist,
+                  std::vector<npc *> &trainers);
+/* Builds only the terrain of the map at idx, as generate_map() would, *
+ * with no characters.  For looking at maps that haven't been visited. */
+void generate_map_terrain(map_t *m, pair_t idx);
+/* Places the trainers on a map just built by generate_map_terrain() on  *
+ * this thread, against distances from the PC's cell rather than the     *
+ * first road cell that generate_map() uses, and keeps them off that     *
+ * cell.  Continues the map's stream, so must come next on the thread.   */
+void generate_map_characters(map_t *m, pair_t pc, dist_maps_t *dist,
+                             std::vector<npc *> &trainers);
+
+/* Maps are built at full resolution, with the height field that roads *
+ * follow, and only packed into a map_t once they're finished.          */
+typedef struct mapgen {
+  terrain_type_t map[MAP_Y][MAP_X];
+  uint8_t height[MAP_Y][MAP_X];
+  int8_t n, s, e, w;
+} mapgen_t;
+
+/* Lays a road from one cell to another and returns its cost */
+typedef uint32_t (*road_router_t)(mapgen_t *m, pair_t from, pair_t to);
+
+/* For benchmarking the road router.  generate_map_roadless() builds the *
+ * map at idx into g as generate_map() would, up to its roads, and       *
+ * generate_roads() then lays them, one route() call per road.           *
+ * astar_path() is the router generate_map() uses.                       */
+void generate_map_roadless(mapgen_t *g, pair_t idx);
+void generate_roads(mapgen_t *g, road_router_t route);
+uint32_t astar_path(mapgen_t *m, pair_t from, pair_t to);
+
+/* How map_terrain() lays out regions.  Diffusion, the original, grows *
+ * them from their seeds a random step at a time.  Voronoi gives each   *
+ * cell to its nearest seed, several cells to a vector operation, and   *
+ * is far faster.  Both draw the same seeds with the same mix of types, *
+ * so regions look alike, but the maps differ, so a world should keep   *
+ * to one mode.  Shared by every thread; set it before generating.      */
+typedef enum terrain_mode {
+  terrain_diffuse,
+  terrain_voronoi,
+  num_terrain_modes
+} terrain_mode_t;
+
+extern const char *terrain_mode_name[num_terrain_modes];
+
+void mapgen_set_terrain_mode(terrain_mode_t t);
+terrain_mode_t mapgen_terrain_mode();
+/* The mode named name, or -1 if there is none */
+int terrain_mode_parse(const char *name);
+
+/* How many Gaussian passes smooth the height field, at least one.  More *
+ * passes make gentler slopes, so roads, which follow them, wander less. *
+ * Like the terrain mode, this changes every map, and is shared by every *
+ * thread; set it before generating.                                    */
+void mapgen_set_smooth_passes(uint32_t passes);
+uint32_t mapgen_smooth_passes();
+
+/* The phases of generate_map(), for profiling */
+typedef enum mapgen_phase {
+  phase_smooth_height,
+  phase_map_terrain,
+  phase_place_boulders,
+  phase_place_trees,
+  phase_build_paths,
+  phase_place_buildings,  /* place_pokemart() and place_center() */
+  phase_pathfind,
+  phase_place_characters,
+  num_mapgen_phases
+} mapgen_phase_t;
+
+extern const char *mapgen_phase_name[num_mapgen_phases];
+
+/* While a profile is set on a thread, generate_map() on that thread adds *
+ * the time each phase takes to ns, and, if allocations is set, the       *
+ * change in what it returns over each phase to allocs.                   */
+typedef struct mapgen_profile {
+  uint64_t ns[num_mapgen_phases];
+  uint64_t allocs[num_mapgen_phases];
+  uint64_t (*allocations)();
+} mapgen_profile_t;
+
+/* NULL turns profiling off, which is the default */
+void mapgen_set_profile(mapgen_profile_t *p);
+
+/* A map frozen into one flat block that holds no pointers, so it can be *
+ * kept in memory or written to disk as is.  The header is followed by   *
+ * num_chars record_char_ts, then terrain_len bytes of (run length,      *
+ * terrain) pairs.  Teams aren't kept; each trainer's team_seed rebuilds *
+ * its team.  Height, which is only used while generating, isn't kept.   */
+typedef struct record_char {
+  pair_t pos;
+  pair_t dir;
+  int32_t next_turn;
+  uint32_t team_seed;
+  character_type_t ctype;
+  movement_type_t mtype;
+  uint8_t defeated;
+  char symbol;
+} record_char_t;
+
+typedef struct map_record {
+  pair_t idx;
+  int8_t n, s, e, w;
+  int32_t num_trainers;
+  uint16_t terrain_len;
+  uint16_t num_chars;
+} map_record_t;
+
+/* Returns a malloc()ed record of map_record_size() bytes */
+map_record_t *map_freeze(map_t *m);
+size_t map_record_size(const map_record_t *r);
+/* The trainers rebuilt are added to trainers, with empty teams. */
+map_t *map_thaw(const map_record_t *r, std::vector<npc *> &trainers);
+
+#endif
@@ -0,0 +1,470 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "poke327.h"
+#include "route.h"
+
+/***********************************************************************
+ * Hack: Avoid the "path to a building" issue by making building cells *
+ * have a large but not infinite movement cost.  This allows the       *
+ * pathfinding algorithm to run without overflowing, but still makes   *
+ * NPCs avoid buildings most of the time since the cost to move on to  *
+ * the building is greater than navigating the building's perimeter.   *
+ ***********************************************************************/
+int32_t move_cost[num_character_types][num_terrain_types] = {
+  { INT_MAX, INT_MAX, 10, 10, 10, 20, 10, INT_MAX, INT_MAX, INT_MAX, 10      },
+  { INT_MAX, INT_MAX, 10, 50, 50, 15, 10, 15,      15,     INT_MAX, INT_MAX },
+  { INT_MAX, INT_MAX, 10, 50, 50, 20, 10, INT_MAX, INT_MAX,INT_MAX, INT_MAX },
+   { INT_MAX, INT_MAX,  7, INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX, INT_MAX,  7, INT_MAX },
+  { INT_MAX, INT_MAX, 10, 50, 50, 20, 10, INT_MAX, INT_MAX,INT_MAX, INT_MAX },
+};
+
+/* Dial's algorithm: since every finite move cost is a small integer  *
+ * below DIAL_BUCKETS, the cells waiting to be settled all lie within  *
+ * DIAL_BUCKETS of the nearest, so a circular array of buckets, one    *
+ * per distance, holds them in order.  Buckets are intrusive doubly    *
+ * linked lists through the cells, so lowering a distance moves a cell *
+ * between buckets in constant time, and nothing is allocated.         *
+ *                                                                     *
+ * The distance maps of several NPC types are made in one pass over    *
+ * one queue: entry f * MAP_CELLS + cell is cell in the map of the f'th *
+ * type.  The types are template arguments, so another pathing NPC     *
+ * type only needs adding to PATHING_TYPES.                            */
+#define DIAL_BUCKETS 64
+#define DIAL_NONE    UINT16_MAX
+#define MAP_CELLS    (MAP_Y * MAP_X)
+
+/* The NPC types with distance maps; num_pathing_types of them */
+#define PATHING_TYPES char_hiker, char_rival, char_other
+
+static const character_type_t pathing_type[] = { PATHING_TYPES };
+
+template <uint32_t num_maps>
+struct dial {
+  uint16_t bucket[DIAL_BUCKETS];
+  uint16_t next[num_maps * MAP_CELLS];
+  uint16_t prev[num_maps * MAP_CELLS];
+  uint8_t queued[num_maps * MAP_CELLS];
+  /* The cost to leave each cell, or INT_MAX if it can't be entered */
+  int32_t cost[num_maps][MAP_CELLS];
+};
+
+template <uint32_t n>
+static void dial_push(dial<n> *q, uint16_t e, int dist)
+{
+  uint16_t *b;
+
+  b = &q->bucket[dist & (DIAL_BUCKETS - 1)];
+  q->prev[e] = DIAL_NONE;
+  if ((q->next[e] = *b) != DIAL_NONE) {
+    q->prev[*b] = e;
+  }
+  *b = e;
+  q->queued[e] = 1;
+}
+
+template <uint32_t n>
+static void dial_unlink(dial<n> *q, uint16_t e, int dist)
+{
+  if (q->prev[e] != DIAL_NONE) {
+    q->next[q->prev[e]] = q->next[e];
+  } else {
+    q->bucket[dist & (DIAL_BUCKETS - 1)] = q->next[e];
+  }
+  if (q->next[e] != DIAL_NONE) {
+    q->prev[q->next[e]] = q->prev[e];
+  }
+  q->queued[e] = 0;
+}
+
+/* Neighbors as offsets from a cell's index */
+static const int16_t pathfind_dirs[8] = {
+  -MAP_X - 1, -MAP_X, -MAP_X + 1,
+  -1,                  1,
+  MAP_X - 1,  MAP_X,  MAP_X + 1,
+};
+
+/* Settles the queued entries, each at distance 0, then every entry    *
+ * they bring below its distance in dist, in order of distance.  The   *
+ * cost of a step is the cost of the cell being left.  Distances are   *
+ * unique, so the order ties are settled in doesn't change them.       */
+template <uint32_t n>
+static void dial_settle(dial<n> *q, int *dist[], uint32_t queued)
+{
+  int32_t step, *cost;
+  uint32_t f, i, cur;
+  uint16_t e, c, nc;
+  int *d;
+
+  for (cur = 0; queued; queued--) {
+    while (q->bucket[cur & (DIAL_BUCKETS - 1)] == DIAL_NONE) {
+      cur++;
+    }
+    e = q->bucket[cur & (DIAL_BUCKETS - 1)];
+    dial_unlink(q, e, cur);
+
+    f = e / MAP_CELLS;
+    c = e % MAP_CELLS;
+    d = dist[f];
+    cost = q->cost[f];
+    step = d[c] + cost[c];
+    for (i = 0; i < 8; i++) {
+      nc = c + pathfind_dirs[i];
+      if (d[nc] > step && cost[nc] != INT_MAX) {
+        if (q->queued[f * MAP_CELLS + nc]) {
+          dial_unlink(q, f * MAP_CELLS + nc, d[nc]);
+        } else {
+          queued++;
+        }
+        d[nc] = step;
+        dial_push(q, f * MAP_CELLS + nc, step);
+      }
+    }
+  }
+}
+
+/* Distance maps from the cell to into dist, one for each of ctypes,  *
+ * over the interior cells each can enter, but only one for each      *
+ * distinct move_cost row; the types that share it get the same view  *
+ * of it.  If from isn't NULL, dist holds the maps from from, a cell  *
+ * next to to, and each is repaired where it can be rather than made  *
+ * over.  The step back to from, then the old path, still reaches     *
+ * every cell, so raising every distance by the cost of that step     *
+ * gives an upper bound that is exact behind the move.  The search    *
+ * from to then only has to visit the cells it brings below that      *
+ * bound: a cell left at its bound can't lead to a neighbor below the *
+ * neighbor's.                                                        */
+template <character_type_t... ctypes>
+static void dial_dists(map_t *m, pair_t from, pair_t to, dist_maps_t *dm)
+{
+  static const character_type_t ctype[] = { ctypes... };
+  static const uint32_t n = sizeof...(ctypes);
+  static_assert(n <= num_pathing_types, "Too many pathing types");
+  dial<n> q;
+  uint32_t f, g, x, y, i, s, queued;
+  int32_t *cost;
+  int *d, *dist[n];
+
+  memset(q.bucket, 0xff, sizeof (q.bucket));
+  memset(q.queued, 0, sizeof (q.queued));
+
+  s = to[dim_y] * MAP_X + to[dim_x];
+  for (queued = f = 0; f < n; f++) {
+    dist[f] = dm->map[f][0];
+    for (g = 0; g < f && memcmp(move_cost[ctype[g]], move_cost[ctype[f]],
+                                sizeof (move_cost[0])); g++)
+      ;
+    dm->of[ctype[f]] = dm->map[g];
+    if (g < f) {
+      continue;
+    }
+
+    /* Pathing NPCs never go on the border */
+    cost = q.cost[f];
+    for (y = 0; y < MAP_Y; y++) {
+      for (x = 0; x < MAP_X; x++) {
+        cost[y * MAP_X + x] = (y && x && y < MAP_Y - 1 && x < MAP_X - 1 ?
+                               move_cost[ctype[f]][m->map[y][x]] : INT_MAX);
+      }
+    }
+
+    d = dist[f];
+    if (from && cost[from[dim_y] * MAP_X + from[dim_x]] != INT_MAX &&
+        cost[s] != INT_MAX) {
+      for (i = 0; i < MAP_CELLS; i++) {
+        if (d[i] != INT_MAX) {
+          d[i] += cost[s];
+        }
+      }
+    } else {
+      for (i = 0; i < MAP_CELLS; i++) {
+        d[i] = INT_MAX;
+      }
+    }
+    d[s] = 0;
+
+    if (cost[s] != INT_MAX) {
+      dial_push(&q, f * MAP_CELLS + s, 0);
+      queued++;
+    }
+  }
+
+  dial_settle(&q, dist, queued);
+}
+
+/* Distance maps for m from an arbitrary cell, into caller-owned arrays. *
+ * Safe to run off the main thread on a map that isn't being played.     */
+void pathfind_from(map_t *m, pair_t from, dist_maps_t *dist)
+{
+  dial_dists<PATHING_TYPES>(m, NULL, from, dist);
+}
+
+/* One pass for every port, an entry per port and cell, as in          *
+ * dial_dists().  Searching out from a port with the cost of the cell  *
+ * being left makes each distance the cost of the cells entered on the *
+ * way to the port, which is what the PC pays walking there.           */
+void pathfind_ports(map_t *m, const pair_t port[num_gates],
+                    int dist[num_gates][MAP_Y][MAP_X])
+{
+  dial<num_gates> q;
+  uint32_t g, x, y, s, queued;
+  int *d[num_gates];
+
+  memset(q.bucket, 0xff, sizeof (q.bucket));
+  memset(q.queued, 0, sizeof (q.queued));
+
+  for (queued = g = 0; g < num_gates; g++) {
+    for (y = 0; y < MAP_Y; y++) {
+      for (x = 0; x < MAP_X; x++) {
+        q.cost[g][y * MAP_X + x] = (y && x && y < MAP_Y - 1 && x < MAP_X - 1 ?
+                                    move_cost[char_pc][m->map[y][x]] :
+                                    INT_MAX);
+        dist[g][y][x] = INT_MAX;
+      }
+    }
+    d[g] = dist[g][0];
+
+    if (port[g][dim_x] < 0) {
+      continue;
+    }
+    s = port[g][dim_y] * MAP_X + port[g][dim_x];
+    if (q.cost[g][s] != INT_MAX) {
+      d[g][s] = 0;
+      dial_push(&q, g * MAP_CELLS + s, 0);
+      queued++;
+    }
+  }
+
+  dial_settle(&q, d, queued);
+}
+
+/* A map's cached distance maps, most recently used first.  Each entry *
+ * is followed by copies of the distinct maps in world.dist, in order. */
+typedef struct dist_entry {
+  pair_t from;
+  struct dist_entry *next;
+} dist_entry_t;
+
+static size_t dist_cache_cap;
+static dist_cache_stats_t dist_stats;
+
+static int (*dist_entry_maps(dist_entry_t *e))[MAP_Y][MAP_X]
+{
+  return (int (*)[MAP_Y][MAP_X]) (e + 1);
+}
+
+/* The maps of world.dist that aren't shared views of an earlier one */
+static uint32_t distinct_maps(uint8_t *distinct)
+{
+  uint32_t f, n;
+
+  for (n = f = 0; f < num_pathing_types; f++) {
+    if ((distinct[f] = world.dist.of[pathing_type[f]] == world.dist.map[f])) {
+      n++;
+    }
+  }
+
+  return n;
+}
+
+void dist_cache_init(size_t cap_kb)
+{
+  dist_cache_cap = cap_kb * 1024;
+}
+
+void dist_cache_free(map_t *m)
+{
+  dist_entry_t *e;
+
+  while ((e = m->dist_cache)) {
+    m->dist_cache = e->next;
+    free(e);
+  }
+  m->dist_bytes = 0;
+}
+
+const dist_cache_stats_t *dist_cache_stats()
+{
+  return &dist_stats;
+}
+
+/* Copies m's maps from from into world.dist, if it has them */
+static int dist_cache_load(map_t *m, pair_t from)
+{
+  uint8_t distinct[num_pathing_types];
+  dist_entry_t *e, **p;
+  uint32_t f, k;
+
+  for (p = &m->dist_cache; (e = *p); p = &e->next) {
+    if (e->from[dim_x] == from[dim_x] && e->from[dim_y] == from[dim_y]) {
+      break;
+    }
+  }
+  if (!e) {
+    dist_stats.misses++;
+    return 0;
+  }
+
+  *p = e->next;
+  e->next = m->dist_cache;
+  m->dist_cache = e;
+
+  distinct_maps(distinct);
+  for (k = f = 0; f < num_pathing_types; f++) {
+    if (distinct[f]) {
+      memcpy(world.dist.map[f], dist_entry_maps(e)[k++],
+             sizeof (world.dist.map[f]));
+    }
+  }
+  dist_stats.hits++;
+
+  return 1;
+}
+
+/* Copies world.dist, made from from, into m's cache, evicting the least *
+ * recently used entry, whose memory is reused, if the cache is full.    */
+static void dist_cache_store(map_t *m, pair_t from)
+{
+  uint8_t distinct[num_pathing_types];
+  dist_entry_t *e, **p;
+  uint32_t f, k, n;
+  size_t size;
+
+  size = sizeof (*e) + distinct_maps(distinct) * sizeof (world.dist.map[0]);
+  if (size > dist_cache_cap) {
+    return;
+  }
+
+  for (n = 0, e = m->dist_cache; e; e = e->next) {
+    n++;
+  }
+  if ((n + 1) * size > dist_cache_cap) {
+    for (p = &m->dist_cache; (*p)->next; p = &(*p)->next)
+      ;
+    e = *p;
+    *p = NULL;
+  } else {
+    e = (dist_entry_t *) malloc(size);
+    m->dist_bytes += size;
+  }
+
+  e->from[dim_x] = from[dim_x];
+  e->from[dim_y] = from[dim_y];
+  for (k = f = 0; f < num_pathing_types; f++) {
+    if (distinct[f]) {
+      memcpy(dist_entry_maps(e)[k++], world.dist.map[f],
+             sizeof (world.dist.map[f]));
+    }
+  }
+  e->next = m->dist_cache;
+  m->dist_cache = e;
+}
+
+void pathfind(map_t *m)
+{
+  world.want_map = m;
+  world.want_from[dim_x] = world.pc.pos[dim_x];
+  world.want_from[dim_y] = world.pc.pos[dim_y];
+}
+
+/* Terrain never changes in play, so the distance maps only need work  *
+ * when the PC has moved since they were made: nothing if they're      *
+ * cached, and only a repair if it moved a single step.                */
+static void pathfind_update()
+{
+  pair_t from, to;
+  map_t *m;
+
+  if (!(m = world.want_map)) {
+    return;
+  }
+  from[dim_x] = world.dist_from[dim_x];
+  from[dim_y] = world.dist_from[dim_y];
+  to[dim_x] = world.want_from[dim_x];
+  to[dim_y] = world.want_from[dim_y];
+
+  if (m == world.dist_map &&
+      to[dim_x] == from[dim_x] && to[dim_y] == from[dim_y]) {
+    return;
+  }
+
+  if (!dist_cache_load(m, to)) {
+    if (m != world.dist_map ||
+        abs(to[dim_x] - from[dim_x]) > 1 || abs(to[dim_y] - from[dim_y]) > 1) {
+      dial_dists<PATHING_TYPES>(m, NULL, to, &world.dist);
+    } else {
+      dial_dists<PATHING_TYPES>(m, from, to, &world.dist);
+    }
+    dist_cache_store(m, to);
+  }
+
+  memset(world.dist.flow_made, 0, sizeof (world.dist.flow_made));
+  world.dist.flow_base = rand() & 0x7;
+  world.dist_map = m;
+  world.dist_from[dim_x] = to[dim_x];
+  world.dist_from[dim_y] = to[dim_y];
+}
+
+const int (*pathfind_dist(character_type_t ctype))[MAP_X]
+{
+  pathfind_update();
+
+  return world.dist.of[ctype];
+}
+
+/* Each cell's neighbor nearest the PC, ties going to the first from   *
+ * base around all_dirs.  Cells that can't reach the PC get FLOW_NONE. */
+static void flow_field(const int dist[MAP_Y][MAP_X], uint8_t flow[MAP_Y][MAP_X],
+                       uint32_t base)
+{
+  const int *d, *n;
+  uint8_t *f, dir[8];
+  int16_t off[8];
+  uint32_t c, i, x, y;
+  int min;
+
+  for (i = 0; i < 8; i++) {
+    dir[i] = (base + i) & 0x7;
+    off[i] = all_dirs[dir[i]][dim_y] * MAP_X + all_dirs[dir[i]][dim_x];
+  }
+
+  d = dist[0];
+  f = flow[0];
+  memset(f, FLOW_NONE, MAP_CELLS);
+  for (y = 1; y < MAP_Y - 1; y++) {
+    for (c = y * MAP_X + 1, x = 1; x < MAP_X - 1; x++, c++) {
+      if (d[c] == INT_MAX) {
+        continue;
+      }
+      for (n = d + c, min = INT_MAX, i = 0; i < 8; i++) {
+        if (n[off[i]] < min) {
+          min = n[off[i]];
+          f[c] = dir[i];
+        }
+      }
+    }
+  }
+}
+
+const uint8_t (*pathfind_flow(character_type_t ctype))[MAP_X]
+{
+  dist_maps_t *dm;
+  uint32_t f;
+
+  pathfind_update();
+
+  /* Types that share a map share its flow field; only pathing types *
+   * have one                                                        */
+  dm = &world.dist;
+  for (f = 0; f < num_pathing_types && dm->of[ctype] != dm->map[f]; f++)
+    ;
+  assert(dm->of[ctype] && f < num_pathing_types);
+  if (!dm->flow_made[f]) {
+    flow_field(dm->map[f], dm->flow[f], dm->flow_base);
+    dm->flow_made[f] = 1;
+  }
+
+  return dm->flow[f];
+}
@@ -13,23 +13,26 @@
 #include "poke327.h"
 #include "io.h"
 #include "parsing.h"
+#include "diffuse.h"
+#include "mapcache.h"
+#include "mapgen.h"
+#include "worldfile.h"
+#include "route.h"
 
 #include <iostream>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <thread>
+#include <atomic>
 
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
 
-typedef struct queue_node {
-  int x, y;
-  struct queue_node *next;
-} queue_node_t;
-
 world_t world;
+
 int emptyCellCheck(std::string value)
 {
     if(value.empty())
@@ -458,891 +461,280 @@ void parsePokemonSpecies(std::ifstream &f)
         std::cout << "failed" << std::endl;
     }
 }
-void npcPokemonSpawn(std::vector<WildPokemon> pokemonTeam)
+/* Builds a trainer's team directly into pokemonTeam.  All randomness *
+ * comes from seed, and the map's distance and the PC's team size are  *
+ * passed in, so that teams can be built concurrently, even for a map  *
+ * that is not the current one.                                        */
+void npcPokemonSpawn(std::vector<WildPokemon> &pokemonTeam, unsigned int *seed,
+                     int distance, uint32_t pc_team_size)
 {
-  
   WildPokemon p;
-  int index = rand() % 1093;
-  p.name = world.pokemon[index].identifier;
-  p.species_id = world.pokemon[index].species_id;
-  determinePokemonLevel(&p);
-  determinePokemonMoves(&p);
-  determinePokemonStats(&p, world.pokemon[index]);
-  determineGenderAndShiny(&p);
-  pokemonTeam.push_back(p);
-
-  int chance = rand() % 10 + 1;
-  if(chance <= 6)
-  {
-    int numPokemon = (world.pc.pokemonTeam.size() + 1);
-    int counter = 0;
-    while(counter < numPokemon)
-    {
-      index = rand() % 1093;
-      p.name = world.pokemon[index].identifier;
-      p.species_id = world.pokemon[index].species_id;
-      determinePokemonLevel(&p);
-      determinePokemonMoves(&p);
-      determinePokemonStats(&p, world.pokemon[index]);
-      determineGenderAndShiny(&p);
-      pokemonTeam.push_back(p);
-      counter++;
-    }
-  }
-}
-pair_t all_dirs[8] = {
-  { -1, -1 },
-  { -1,  0 },
-  { -1,  1 },
-  {  0, -1 },
-  {  0,  1 },
-  {  1, -1 },
-  {  1,  0 },
-  {  1,  1 },
-};
-
-static int32_t path_cmp(const void *key, const void *with) {
-  return ((path_t *) key)->cost - ((path_t *) with)->cost;
-}
+  int index;
+  int numPokemon = 1;
 
-static int32_t edge_penalty(int8_t x, int8_t y)
-{
-  return (x == 1 || y == 1 || x == MAP_X - 2 || y == MAP_Y - 2) ? 2 : 1;
-}
-
-static void dijkstra_path(map_t *m, pair_t from, pair_t to)
-{
-  static path_t path[MAP_Y][MAP_X], *p;
-  static uint32_t initialized = 0;
-  heap_t h;
-  int32_t x, y;
-
-  if (!initialized) {
-    for (y = 0; y < MAP_Y; y++) {
-      for (x = 0; x < MAP_X; x++) {
-        path[y][x].pos[dim_y] = y;
-        path[y][x].pos[dim_x] = x;
-      }
-    }
-    initialized = 1;
+  if (pokemon_rand(seed) % 10 + 1 <= 6) {
+    numPokemon += pc_team_size + 1;
   }
-  
-  for (y = 0; y < MAP_Y; y++) {
-    for (x = 0; x < MAP_X; x++) {
-      path[y][x].cost = INT_MAX;
-    }
-  }
-
-  path[from[dim_y]][from[dim_x]].cost = 0;
-
-  heap_init(&h, path_cmp, NULL);
-
-  for (y = 1; y < MAP_Y - 1; y++) {
-    for (x = 1; x < MAP_X - 1; x++) {
-      path[y][x].hn = heap_insert(&h, &path[y][x]);
-    }
-  }
-
-  while ((p = (path_t *) heap_remove_min(&h))) {
-    p->hn = NULL;
-
-    if ((p->pos[dim_y] == to[dim_y]) && p->pos[dim_x] == to[dim_x]) {
-      for (x = to[dim_x], y = to[dim_y];
-           (x != from[dim_x]) || (y != from[dim_y]);
-           p = &path[y][x], x = p->from[dim_x], y = p->from[dim_y]) {
-        mapxy(x, y) = ter_path;
-        heightxy(x, y) = 0;
-      }
-      heap_delete(&h);
-      return;
-    }
-
-    if ((path[p->pos[dim_y] - 1][p->pos[dim_x]    ].hn) &&
-        (path[p->pos[dim_y] - 1][p->pos[dim_x]    ].cost >
-         ((p->cost + heightpair(p->pos)) *
-          edge_penalty(p->pos[dim_x], p->pos[dim_y] - 1)))) {
-      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].cost =
-        ((p->cost + heightpair(p->pos)) *
-         edge_penalty(p->pos[dim_x], p->pos[dim_y] - 1));
-      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].from[dim_y] = p->pos[dim_y];
-      path[p->pos[dim_y] - 1][p->pos[dim_x]    ].from[dim_x] = p->pos[dim_x];
-      heap_decrease_key_no_replace(&h, path[p->pos[dim_y] - 1]
-                                           [p->pos[dim_x]    ].hn);
-    }
-    if ((path[p->pos[dim_y]    ][p->pos[dim_x] - 1].hn) &&
-        (path[p->pos[dim_y]    ][p->pos[dim_x] - 1].cost >
-         ((p->cost + heightpair(p->pos)) *
-          edge_penalty(p->pos[dim_x] - 1, p->pos[dim_y])))) {
-      path[p->pos[dim_y]][p->pos[dim_x] - 1].cost =
-        ((p->cost + heightpair(p->pos)) *
-         edge_penalty(p->pos[dim_x] - 1, p->pos[dim_y]));
-      path[p->pos[dim_y]    ][p->pos[dim_x] - 1].from[dim_y] = p->pos[dim_y];
-      path[p->pos[dim_y]    ][p->pos[dim_x] - 1].from[dim_x] = p->pos[dim_x];
-      heap_decrease_key_no_replace(&h, path[p->pos[dim_y]    ]
-                                           [p->pos[dim_x] - 1].hn);
-    }
-    if ((path[p->pos[dim_y]    ][p->pos[dim_x] + 1].hn) &&
-        (path[p->pos[dim_y]    ][p->pos[dim_x] + 1].cost >
-         ((p->cost + heightpair(p->pos)) *
-          edge_penalty(p->pos[dim_x] + 1, p->pos[dim_y])))) {
-      path[p->pos[dim_y]][p->pos[dim_x] + 1].cost =
-        ((p->cost + heightpair(p->pos)) *
-         edge_penalty(p->pos[dim_x] + 1, p->pos[dim_y]));
-      path[p->pos[dim_y]    ][p->pos[dim_x] + 1].from[dim_y] = p->pos[dim_y];
-      path[p->pos[dim_y]    ][p->pos[dim_x] + 1].from[dim_x] = p->pos[dim_x];
-      heap_decrease_key_no_replace(&h, path[p->pos[dim_y]    ]
-                                           [p->pos[dim_x] + 1].hn);
-    }
-    if ((path[p->pos[dim_y] + 1][p->pos[dim_x]    ].hn) &&
-        (path[p->pos[dim_y] + 1][p->pos[dim_x]    ].cost >
-         ((p->cost + heightpair(p->pos)) *
-          edge_penalty(p->pos[dim_x], p->pos[dim_y] + 1)))) {
-      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].cost =
-        ((p->cost + heightpair(p->pos)) *
-         edge_penalty(p->pos[dim_x], p->pos[dim_y] + 1));
-      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].from[dim_y] = p->pos[dim_y];
-      path[p->pos[dim_y] + 1][p->pos[dim_x]    ].from[dim_x] = p->pos[dim_x];
-      heap_decrease_key_no_replace(&h, path[p->pos[dim_y] + 1]
-                                           [p->pos[dim_x]    ].hn);
-    }
+  pokemonTeam.reserve(pokemonTeam.size() + numPokemon);
+
+  while (numPokemon--) {
+    index = pokemon_rand(seed) % 1093;
+    p.name = world.pokemon[index].identifier;
+    p.species_id = world.pokemon[index].species_id;
+    determinePokemonLevel(&p, seed, distance);
+    determinePokemonMoves(&p, seed);
+    determinePokemonStats(&p, world.pokemon[index], seed);
+    determineGenderAndShiny(&p, seed);
+    p.capturedStatus = npc_owned;
+    pokemonTeam.push_back(p);
   }
 }
 
-static int build_paths(map_t *m)
+/* Team generation scans the whole moves and stats tables for every  *
+ * Pokemon, so it dominates map entry.  Trainers are independent once *
+ * placed, so their teams are built on a pool of worker threads.  Each *
+ * trainer's team comes from its own team_seed, which keeps teams      *
+ * reproducible regardless of how the work is scheduled.               */
+void generate_npc_teams(std::vector<npc *> &trainers, int distance,
+                        uint32_t pc_team_size)
 {
-  pair_t from, to;
-
-  /*  printf("%d %d %d %d\n", m->n, m->s, m->e, m->w);*/
+  std::vector<unsigned int> seeds(trainers.size());
+  std::vector<std::thread> workers;
+  std::atomic<size_t> next(0);
+  size_t i, num_workers;
 
-  if (m->e != -1 && m->w != -1) {
-    from[dim_x] = 1;
-    to[dim_x] = MAP_X - 2;
-    from[dim_y] = m->w;
-    to[dim_y] = m->e;
-
-    dijkstra_path(m, from, to);
+  for (i = 0; i < trainers.size(); i++) {
+    seeds[i] = trainers[i]->team_seed;
   }
 
-  if (m->n != -1 && m->s != -1) {
-    from[dim_y] = 1;
-    to[dim_y] = MAP_Y - 2;
-    from[dim_x] = m->n;
-    to[dim_x] = m->s;
-
-    dijkstra_path(m, from, to);
+  num_workers = std::thread::hardware_concurrency();
+  if (num_workers > trainers.size()) {
+    num_workers = trainers.size();
   }
 
-  if (m->e == -1) {
-    if (m->s == -1) {
-      from[dim_x] = 1;
-      from[dim_y] = m->w;
-      to[dim_x] = m->n;
-      to[dim_y] = 1;
-    } else {
-      from[dim_x] = 1;
-      from[dim_y] = m->w;
-      to[dim_x] = m->s;
-      to[dim_y] = MAP_Y - 2;
-    }
-
-    dijkstra_path(m, from, to);
-  }
+  auto work = [&]() {
+    size_t t;
 
-  if (m->w == -1) {
-    if (m->s == -1) {
-      from[dim_x] = MAP_X - 2;
-      from[dim_y] = m->e;
-      to[dim_x] = m->n;
-      to[dim_y] = 1;
-    } else {
-      from[dim_x] = MAP_X - 2;
-      from[dim_y] = m->e;
-      to[dim_x] = m->s;
-      to[dim_y] = MAP_Y - 2;
+    while ((t = next++) < trainers.size()) {
+      npcPokemonSpawn(trainers[t]->pokemonTeam, &seeds[t],
+                      distance, pc_team_size);
     }
+  };
 
-    dijkstra_path(m, from, to);
+  if (num_workers <= 1) {
+    work();
+    return;
   }
 
-  if (m->n == -1) {
-    if (m->e == -1) {
-      from[dim_x] = 1;
-      from[dim_y] = m->w;
-      to[dim_x] = m->s;
-      to[dim_y] = MAP_Y - 2;
-    } else {
-      from[dim_x] = MAP_X - 2;
-      from[dim_y] = m->e;
-      to[dim_x] = m->s;
-      to[dim_y] = MAP_Y - 2;
-    }
-
-    dijkstra_path(m, from, to);
+  for (i = 0; i < num_workers; i++) {
+    workers.push_back(std::thread(work));
   }
-
-  if (m->s == -1) {
-    if (m->e == -1) {
-      from[dim_x] = 1;
-      from[dim_y] = m->w;
-      to[dim_x] = m->n;
-      to[dim_y] = 1;
-    } else {
-      from[dim_x] = MAP_X - 2;
-      from[dim_y] = m->e;
-      to[dim_x] = m->n;
-      to[dim_y] = 1;
-    }
-
-    dijkstra_path(m, from, to);
+  for (i = 0; i < num_workers; i++) {
+    workers[i].join();
   }
-
-  return 0;
 }
 
-static int gaussian[5][5] = {
-  {  1,  4,  7,  4,  1 },
-  {  4, 16, 26, 16,  4 },
-  {  7, 26, 41, 26,  7 },
-  {  4, 16, 26, 16,  4 },
-  {  1,  4,  7,  4,  1 }
-};
-
-static int smooth_height(map_t *m)
+void init_pc()
 {
-  int32_t i, x, y;
-  int32_t s, t, p, q;
-  queue_node_t *head, *tail, *tmp;
-  /*  FILE *out;*/
-  uint8_t height[MAP_Y][MAP_X];
-
-  memset(&height, 0, sizeof (height));
-
-  /* Seed with some values */
-  for (i = 1; i < 255; i += 20) {
-    do {
-      x = rand() % MAP_X;
-      y = rand() % MAP_Y;
-    } while (height[y][x]);
-    height[y][x] = i;
-    if (i == 1) {
-      head = tail = (queue_node_t *) malloc(sizeof (*tail));
-    } else {
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-    }
-    tail->next = NULL;
-    tail->x = x;
-    tail->y = y;
-  }
-
-  /*
-  out = fopen("seeded.pgm", "w");
-  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
-  fwrite(&height, sizeof (height), 1, out);
-  fclose(out);
-  */
-  
-  /* Diffuse the vaules to fill the space */
-  while (head) {
-    x = head->x;
-    y = head->y;
-    i = height[y][x];
-
-    if (x - 1 >= 0 && y - 1 >= 0 && !height[y - 1][x - 1]) {
-      height[y - 1][x - 1] = i;
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-      tail->next = NULL;
-      tail->x = x - 1;
-      tail->y = y - 1;
-    }
-    if (x - 1 >= 0 && !height[y][x - 1]) {
-      height[y][x - 1] = i;
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-      tail->next = NULL;
-      tail->x = x - 1;
-      tail->y = y;
-    }
-    if (x - 1 >= 0 && y + 1 < MAP_Y && !height[y + 1][x - 1]) {
-      height[y + 1][x - 1] = i;
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-      tail->next = NULL;
-      tail->x = x - 1;
-      tail->y = y + 1;
-    }
-    if (y - 1 >= 0 && !height[y - 1][x]) {
-      height[y - 1][x] = i;
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-      tail->next = NULL;
-      tail->x = x;
-      tail->y = y - 1;
-    }
-    if (y + 1 < MAP_Y && !height[y + 1][x]) {
-      height[y + 1][x] = i;
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-      tail->next = NULL;
-      tail->x = x;
-      tail->y = y + 1;
-    }
-    if (x + 1 < MAP_X && y - 1 >= 0 && !height[y - 1][x + 1]) {
-      height[y - 1][x + 1] = i;
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-      tail->next = NULL;
-      tail->x = x + 1;
-      tail->y = y - 1;
-    }
-    if (x + 1 < MAP_X && !height[y][x + 1]) {
-      height[y][x + 1] = i;
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-      tail->next = NULL;
-      tail->x = x + 1;
-      tail->y = y;
-    }
-    if (x + 1 < MAP_X && y + 1 < MAP_Y && !height[y + 1][x + 1]) {
-      height[y + 1][x + 1] = i;
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-      tail->next = NULL;
-      tail->x = x + 1;
-      tail->y = y + 1;
-    }
-
-    tmp = head;
-    head = head->next;
-    free(tmp);
-  }
-
-  /* And smooth it a bit with a gaussian convolution */
-  for (y = 0; y < MAP_Y; y++) {
-    for (x = 0; x < MAP_X; x++) {
-      for (s = t = p = 0; p < 5; p++) {
-        for (q = 0; q < 5; q++) {
-          if (y + (p - 2) >= 0 && y + (p - 2) < MAP_Y &&
-              x + (q - 2) >= 0 && x + (q - 2) < MAP_X) {
-            s += gaussian[p][q];
-            t += height[y + (p - 2)][x + (q - 2)] * gaussian[p][q];
-          }
-        }
-      }
-      m->height[y][x] = t / s;
-    }
-  }
-  /* Let's do it again, until it's smooth like Kenny G. */
-  for (y = 0; y < MAP_Y; y++) {
-    for (x = 0; x < MAP_X; x++) {
-      for (s = t = p = 0; p < 5; p++) {
-        for (q = 0; q < 5; q++) {
-          if (y + (p - 2) >= 0 && y + (p - 2) < MAP_Y &&
-              x + (q - 2) >= 0 && x + (q - 2) < MAP_X) {
-            s += gaussian[p][q];
-            t += height[y + (p - 2)][x + (q - 2)] * gaussian[p][q];
-          }
-        }
-      }
-      m->height[y][x] = t / s;
-    }
-  }
-
-  /*
-  out = fopen("diffused.pgm", "w");
-  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
-  fwrite(&height, sizeof (height), 1, out);
-  fclose(out);
-
-  out = fopen("smoothed.pgm", "w");
-  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
-  fwrite(&m->height, sizeof (m->height), 1, out);
-  fclose(out);
-  */
-
-  return 0;
-}
+  int x, y;
 
-static void find_building_location(map_t *m, pair_t p)
-{
   do {
-    p[dim_x] = rand() % (MAP_X - 3) + 1;
-    p[dim_y] = rand() % (MAP_Y - 3) + 1;
-
-    if ((((mapxy(p[dim_x] - 1, p[dim_y]    ) == ter_path)     &&
-          (mapxy(p[dim_x] - 1, p[dim_y] + 1) == ter_path))    ||
-         ((mapxy(p[dim_x] + 2, p[dim_y]    ) == ter_path)     &&
-          (mapxy(p[dim_x] + 2, p[dim_y] + 1) == ter_path))    ||
-         ((mapxy(p[dim_x]    , p[dim_y] - 1) == ter_path)     &&
-          (mapxy(p[dim_x] + 1, p[dim_y] - 1) == ter_path))    ||
-         ((mapxy(p[dim_x]    , p[dim_y] + 2) == ter_path)     &&
-          (mapxy(p[dim_x] + 1, p[dim_y] + 2) == ter_path)))   &&
-        (((mapxy(p[dim_x]    , p[dim_y]    ) != ter_mart)     &&
-          (mapxy(p[dim_x]    , p[dim_y]    ) != ter_center)   &&
-          (mapxy(p[dim_x] + 1, p[dim_y]    ) != ter_mart)     &&
-          (mapxy(p[dim_x] + 1, p[dim_y]    ) != ter_center)   &&
-          (mapxy(p[dim_x]    , p[dim_y] + 1) != ter_mart)     &&
-          (mapxy(p[dim_x]    , p[dim_y] + 1) != ter_center)   &&
-          (mapxy(p[dim_x] + 1, p[dim_y] + 1) != ter_mart)     &&
-          (mapxy(p[dim_x] + 1, p[dim_y] + 1) != ter_center))) &&
-        (((mapxy(p[dim_x]    , p[dim_y]    ) != ter_path)     &&
-          (mapxy(p[dim_x] + 1, p[dim_y]    ) != ter_path)     &&
-          (mapxy(p[dim_x]    , p[dim_y] + 1) != ter_path)     &&
-          (mapxy(p[dim_x] + 1, p[dim_y] + 1) != ter_path)))) {
-          break;
-    }
-  } while (1);
-}
-
-static int place_pokemart(map_t *m)
-{
-  pair_t p;
-
-  find_building_location(m, p);
-
-  mapxy(p[dim_x]    , p[dim_y]    ) = ter_mart;
-  mapxy(p[dim_x] + 1, p[dim_y]    ) = ter_mart;
-  mapxy(p[dim_x]    , p[dim_y] + 1) = ter_mart;
-  mapxy(p[dim_x] + 1, p[dim_y] + 1) = ter_mart;
-
-  return 0;
-}
-
-static int place_center(map_t *m)
-{  pair_t p;
+    x = rand() % (MAP_X - 2) + 1;
+    y = rand() % (MAP_Y - 2) + 1;
+  } while (world.cur_map->map[y][x] != ter_path || world.cur_map->cmap[y][x]);
 
-  find_building_location(m, p);
+  world.pc.pos[dim_x] = x;
+  world.pc.pos[dim_y] = y;
+  world.pc.symbol = '@';
 
-  mapxy(p[dim_x]    , p[dim_y]    ) = ter_center;
-  mapxy(p[dim_x] + 1, p[dim_y]    ) = ter_center;
-  mapxy(p[dim_x]    , p[dim_y] + 1) = ter_center;
-  mapxy(p[dim_x] + 1, p[dim_y] + 1) = ter_center;
+  world.cur_map->cmap[y][x] = &world.pc;
+  world.pc.next_turn = 0;
 
-  return 0;
+  heap_insert(&world.cur_map->turn, &world.pc);
 }
 
-static int map_terrain(map_t *m, int8_t n, int8_t s, int8_t e, int8_t w)
+void place_pc()
 {
-  int32_t i, x, y;
-  queue_node_t *head, *tail, *tmp;
-  //  FILE *out;
-  int num_grass, num_clearing, num_mountain, num_forest,num_water, num_total;
-  terrain_type_t type;
-  int added_current = 0;
-  
-  num_grass = rand() % 4 + 2;
-  num_clearing = rand() % 4 + 2;
-  num_mountain = rand() % 2 + 1;
-  num_forest = rand() % 2 + 1;
-   num_water = rand() % 2 + 1;
-  num_total = num_grass + num_clearing + num_mountain + num_forest +num_water;
-
-  memset(&m->map, 0, sizeof (m->map));
-
-  /* Seed with some values */
-  for (i = 0; i < num_total; i++) {
-    do {
-      x = rand() % MAP_X;
-      y = rand() % MAP_Y;
-    } while (m->map[y][x]);
-    if (i == 0) {
-      type = ter_grass;
-    } else if (i == num_grass) {
-      type = ter_clearing;
-    } else if (i == num_grass + num_clearing) {
-      type = ter_mountain;
-    } else if (i == num_grass + num_clearing + num_mountain) {
-      type = ter_forest;
-    } else if (i == num_grass + num_clearing + num_mountain + num_forest) {
-      type = ter_water;
-    }
-    m->map[y][x] = type;
-    if (i == 0) {
-      head = tail = (queue_node_t *) malloc(sizeof (*tail));
-    } else {
-      tail->next = (queue_node_t *) malloc(sizeof (*tail));
-      tail = tail->next;
-    }
-    tail->next = NULL;
-    tail->x = x;
-    tail->y = y;
-  }
-
-  /*
-  out = fopen("seeded.pgm", "w");
-  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
-  fwrite(&m->map, sizeof (m->map), 1, out);
-  fclose(out);
-  */
-
-  /* Diffuse the vaules to fill the space */
-  while (head) {
-    x = head->x;
-    y = head->y;
-    i = m->map[y][x];
-    
-    if (x - 1 >= 0 && !m->map[y][x - 1]) {
-      if ((rand() % 100) < 80) {
-        m->map[y][x - 1] = (terrain_type_t) i;
-        tail->next = (queue_node_t *) malloc(sizeof (*tail));
-        tail = tail->next;
-        tail->next = NULL;
-        tail->x = x - 1;
-        tail->y = y;
-      } else if (!added_current) {
-        added_current = 1;
-        m->map[y][x] = (terrain_type_t) i;
-        tail->next = (queue_node_t *) malloc(sizeof (*tail));
-        tail = tail->next;
-        tail->next = NULL;
-        tail->x = x;
-        tail->y = y;
-      }
-    }
-
-    if (y - 1 >= 0 && !m->map[y - 1][x]) {
-      if ((rand() % 100) < 20) {
-        m->map[y - 1][x] = (terrain_type_t) i;
-        tail->next = (queue_node_t *) malloc(sizeof (*tail));
-        tail = tail->next;
-        tail->next = NULL;
-        tail->x = x;
-        tail->y = y - 1;
-      } else if (!added_current) {
-        added_current = 1;
-        m->map[y][x] = (terrain_type_t) i;
-        tail->next = (queue_node_t *) malloc(sizeof (*tail));
-        tail = tail->next;
-        tail->next = NULL;
-        tail->x = x;
-        tail->y = y;
-      }
-    }
-
-    if (y + 1 < MAP_Y && !m->map[y + 1][x]) {
-      if ((rand() % 100) < 20) {
-        m->map[y + 1][x] = (terrain_type_t) i;
-        tail->next = (queue_node_t *) malloc(sizeof (*tail));
-        tail = tail->next;
-        tail->next = NULL;
-        tail->x = x;
-        tail->y = y + 1;
-      } else if (!added_current) {
-        added_current = 1;
-        m->map[y][x] = (terrain_type_t) i;
-        tail->next = (queue_node_t *) malloc(sizeof (*tail));
-        tail = tail->next;
-        tail->next = NULL;
-        tail->x = x;
-        tail->y = y;
-      }
-    }
-
-    if (x + 1 < MAP_X && !m->map[y][x + 1]) {
-      if ((rand() % 100) < 80) {
-        m->map[y][x + 1] = (terrain_type_t) i;
-        tail->next = (queue_node_t *) malloc(sizeof (*tail));
-        tail = tail->next;
-        tail->next = NULL;
-        tail->x = x + 1;
-        tail->y = y;
-      } else if (!added_current) {
-        added_current = 1;
-        m->map[y][x] = (terrain_type_t) i;
-        tail->next = (queue_node_t *) malloc(sizeof (*tail));
-        tail = tail->next;
-        tail->next = NULL;
-        tail->x = x;
-        tail->y = y;
-      }
-    }
-
-    added_current = 0;
-    tmp = head;
-    head = head->next;
-    free(tmp);
-  }
+  character *c;
 
-  /*
-  out = fopen("diffused.pgm", "w");
-  fprintf(out, "P5\n%u %u\n255\n", MAP_X, MAP_Y);
-  fwrite(&m->map, sizeof (m->map), 1, out);
-  fclose(out);
-  */
-  
-  for (y = 0; y < MAP_Y; y++) {
-    for (x = 0; x < MAP_X; x++) {
-      if (y == 0 || y == MAP_Y - 1 ||
-          x == 0 || x == MAP_X - 1) {
-        mapxy(x, y) = ter_boulder;
-      }
-    }
+  if (world.pc.pos[dim_x] == 1) {
+    world.pc.pos[dim_x] = MAP_X - 2;
+  } else if (world.pc.pos[dim_x] == MAP_X - 2) {
+    world.pc.pos[dim_x] = 1;
+  } else if (world.pc.pos[dim_y] == 1) {
+    world.pc.pos[dim_y] = MAP_Y - 2;
+  } else if (world.pc.pos[dim_y] == MAP_Y - 2) {
+    world.pc.pos[dim_y] = 1;
   }
 
-  m->n = n;
-  m->s = s;
-  m->e = e;
-  m->w = w;
+  world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = &world.pc;
 
-  if (n != -1) {
-    mapxy(n,         0        ) = ter_exit;
-    mapxy(n,         1        ) = ter_path;
-  }
-  if (s != -1) {
-    mapxy(s,         MAP_Y - 1) = ter_exit;
-    mapxy(s,         MAP_Y - 2) = ter_path;
-  }
-  if (w != -1) {
-    mapxy(0,         w        ) = ter_exit;
-    mapxy(1,         w        ) = ter_path;
-  }
-  if (e != -1) {
-    mapxy(MAP_X - 1, e        ) = ter_exit;
-    mapxy(MAP_X - 2, e        ) = ter_path;
+  if ((c = (character *) heap_peek_min(&world.cur_map->turn))) {
+    world.pc.next_turn = c->next_turn;
+  } else {
+    world.pc.next_turn = 0;
   }
-
-  return 0;
 }
 
-static int place_boulders(map_t *m)
+/* Neighboring maps are built speculatively on a worker thread while   *
+ * the PC closes in on a gate (or has lingered on a map), so that       *
+ * walking through the gate finds the map already done.  Only one map   *
+ * is in flight at a time.  The worker owns the map until done is set;  *
+ * the game thread then joins it and installs the map into the world.   *
+ * The PC's team size is fixed when the job starts, so the worker never *
+ * reads the world.  Trainers are placed against distances from the     *
+ * cell the PC will arrive on.                                          */
+typedef struct prefetch {
+  std::thread worker;
+  std::atomic<int> done;
+  int busy;
+  pair_t idx;
+  pair_t pc_pos;
+  uint32_t pc_team_size;
+  map_t *m;
+  map_t *last_map;
+  int turns_on_map;
+} prefetch_t;
+
+static prefetch_t prefetch;
+
+/* Loads the map at idx, with its trainers, from the world file if it's *
+ * there, and returns 0.  Otherwise generates its terrain and returns 1; *
+ * its trainers are placed by populate_map() once the PC's cell is       *
+ * known, and nothing else may draw from this thread's mapgen stream     *
+ * until then.                                                           */
+static int build_map(pair_t idx, map_t **m, std::vector<npc *> &trainers)
 {
-  int i;
-  int x, y;
+  const map_record_t *r;
 
-  for (i = 0; i < MIN_BOULDERS || rand() % 100 < BOULDER_PROB; i++) {
-    y = rand() % (MAP_Y - 2) + 1;
-    x = rand() % (MAP_X - 2) + 1;
-    if (m->map[y][x] != ter_forest && m->map[y][x] != ter_path) {
-      m->map[y][x] = ter_boulder;
-    }
+  if ((r = world_file_record(idx))) {
+    *m = map_thaw(r, trainers);
+    return 0;
   }
+  *m = (map_t *) malloc(sizeof (**m));
+  generate_map_terrain(*m, idx);
 
-  return 0;
+  return 1;
 }
 
-static int place_trees(map_t *m)
+/* Places a generated map's trainers, against distances from the PC's *
+ * cell, then builds every trainer's team.  The distance maps are      *
+ * scratch space, and are only written when the map was generated.    */
+static void populate_map(map_t *m, int generated, pair_t pc,
+                         uint32_t pc_team_size, dist_maps_t *dist,
+                         std::vector<npc *> &trainers)
 {
-  int i;
-  int x, y;
-  
-  for (i = 0; i < MIN_TREES || rand() % 100 < TREE_PROB; i++) {
-    y = rand() % (MAP_Y - 2) + 1;
-    x = rand() % (MAP_X - 2) + 1;
-    if (m->map[y][x] != ter_mountain && m->map[y][x] != ter_path &&
-        m->map[y][x] != ter_water) {
-      m->map[y][x] = ter_tree;
-    }
+  if (generated) {
+    generate_map_characters(m, pc, dist, trainers);
   }
-
-  return 0;
+  m->pc_team_size = pc_team_size;
+  generate_npc_teams(trainers, map_distance(m->idx), pc_team_size);
 }
 
-void rand_pos(pair_t pos)
+static void prefetch_build(prefetch_t *pf)
 {
-  pos[dim_x] = (rand() % (MAP_X - 2)) + 1;
-  pos[dim_y] = (rand() % (MAP_Y - 2)) + 1;
-}
+  std::vector<npc *> trainers;
+  dist_maps_t dist;
+  int generated;
 
-void new_hiker()
-{
-  pair_t pos;
-  npc *c;
+  generated = build_map(pf->idx, &pf->m, trainers);
+  populate_map(pf->m, generated, pf->pc_pos, pf->pc_team_size,
+               &dist, trainers);
 
-  do {
-    rand_pos(pos);
-  } while (world.hiker_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
-           world.cur_map->cmap[pos[dim_y]][pos[dim_x]]         ||
-           pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4            ||
-           pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
-
-  world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c = new npc;
-  c->pos[dim_y] = pos[dim_y];
-  c->pos[dim_x] = pos[dim_x];
-  c->ctype = char_hiker;
-  c->mtype = move_hiker;
-  c->dir[dim_x] = 0;
-  c->dir[dim_y] = 0;
-  c->defeated = 0;
-  c->symbol = 'h';
-  c->next_turn = 0;
-
-  
-  give_npc_pokemon(c);
-
-  heap_insert(&world.cur_map->turn, c);
-  world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c;
-
-  //  printf("Hiker at %d,%d\n", pos[dim_x], pos[dim_y]);
+  pf->done = 1;
 }
 
-void new_rival()
-{
-  pair_t pos;
-  npc *c;
 
-  do {
-    rand_pos(pos);
-  } while (world.rival_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
-           world.rival_dist[pos[dim_y]][pos[dim_x]] < 0        ||
-           world.cur_map->cmap[pos[dim_y]][pos[dim_x]]         ||
-           pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4            ||
-           pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
-
-  world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c = new npc;
-  c->pos[dim_y] = pos[dim_y];
-  c->pos[dim_x] = pos[dim_x];
-  c->ctype = char_rival;
-  c->mtype = move_rival;
-  c->dir[dim_x] = 0;
-  c->dir[dim_y] = 0;
-  c->defeated = 0;
-  c->symbol = 'r';
-  c->next_turn = 0;
- 
-  give_npc_pokemon(c);
-
-  heap_insert(&world.cur_map->turn, c);
-  world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c;
-}
-
-void new_swimmer()
+/* Joins the worker and hands its map to the cache, unless the map was *
+ * cached while it ran (a teleport, say), in which case it is dropped.  */
+static void prefetch_finish()
 {
-  pair_t pos;
-  npc *c;
-   
-  do {
-    rand_pos(pos);
-  } while (world.cur_map->map[pos[dim_y]][pos[dim_x]] != ter_water ||
-           world.cur_map->cmap[pos[dim_y]][pos[dim_x]]);
-
-  world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c = new npc;
-  c->pos[dim_y] = pos[dim_y];
-  c->pos[dim_x] = pos[dim_x];
-  c->ctype = char_swimmer;
-  c->mtype = move_swim;
-  c->dir[dim_x] = 0;
-  c->dir[dim_y] = 0;
-  c->defeated = 0;
-  c->symbol = 's';
-  c->next_turn = 0;
-  heap_insert(&world.cur_map->turn, c);
-  world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c;
-}
+  prefetch.worker.join();
+  prefetch.busy = 0;
 
-void new_char_other()
-{
-  pair_t pos;
-  npc *c;
-
-  do {
-    rand_pos(pos);
-  } while (world.rival_dist[pos[dim_y]][pos[dim_x]] == INT_MAX ||
-           world.rival_dist[pos[dim_y]][pos[dim_x]] < 0        ||
-           world.cur_map->cmap[pos[dim_y]][pos[dim_x]]         ||
-           pos[dim_x] < 3 || pos[dim_x] > MAP_X - 4            ||
-           pos[dim_y] < 3 || pos[dim_y] > MAP_Y - 4);
-
-  world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c = new npc;
-  c->pos[dim_y] = pos[dim_y];
-  c->pos[dim_x] = pos[dim_x];
-  c->ctype = char_other;
-  switch (rand() % 4) {
-  case 0:
-    c->mtype = move_pace;
-    c->symbol = 'p';
-    break;
-  case 1:
-    c->mtype = move_wander;
-    c->symbol = 'w';
-    break;
-  case 2:
-    c->mtype = move_sentry;
-    c->symbol = 's';
-    break;
-  case 3:
-    c->mtype = move_walk;
-    c->symbol = 'n';
-    break;
+  if (map_cache_contains(prefetch.idx)) {
+    map_delete(prefetch.m);
+  } else {
+    map_cache_insert(prefetch.m);
   }
-  rand_dir(c->dir);
-  c->defeated = 0;
-  c->next_turn = 0;
-  
-  
-  give_npc_pokemon(c);
-
-  heap_insert(&world.cur_map->turn, c);
-  world.cur_map->cmap[pos[dim_y]][pos[dim_x]] = c;
 }
 
-void place_characters()
+static void prefetch_start(pair_t idx, int16_t pc_x, int16_t pc_y)
 {
-  world.cur_map->num_trainers = 2;
-
-  //Always place a hiker and a rival, then place a random number of others
-  new_hiker();
-  new_rival();
-  do {
-    //higher probability of non- hikers and rivals
-    switch(rand() % 10) {
-    case 0:
-      new_hiker();
-      break;
-    case 1:
-     new_rival();
-      break;
-    default:
-      new_char_other();
-      break;
-    }
-    /* Game attempts to continue to place trainers until the probability *
-     * roll fails, but if the map is full (or almost full), it's         *
-     * impossible (or very difficult) to continue to add, so we abort if *
-     * we've tried MAX_TRAINER_TRIES times.                              */
-  } while (++world.cur_map->num_trainers < MIN_TRAINERS ||
-           ((rand() % 100) < ADD_TRAINER_PROB));
+  prefetch.idx[dim_x] = idx[dim_x];
+  prefetch.idx[dim_y] = idx[dim_y];
+  prefetch.pc_pos[dim_x] = pc_x;
+  prefetch.pc_pos[dim_y] = pc_y;
+  prefetch.pc_team_size = world.pc.pokemonTeam.size();
+  prefetch.done = 0;
+  prefetch.busy = 1;
+  prefetch.worker = std::thread(prefetch_build, &prefetch);
 }
 
-void init_pc()
+/* Called after every PC move.  Finishes a completed job, then starts  *
+ * one for an unbuilt neighbor if the PC is near its gate, or for any  *
+ * unbuilt neighbor once the PC has lingered on this map.              */
+static void prefetch_update()
 {
-  int x, y;
-
-  do {
-    x = rand() % (MAP_X - 2) + 1;
-    y = rand() % (MAP_Y - 2) + 1;
-  } while (world.cur_map->map[y][x] != ter_path);
+  map_t *m = world.cur_map;
+  pair_t idx;
+  int16_t gate[4][2], arrive[4][2], step[4][2];
+  int i, linger, dx, dy;
 
-  world.pc.pos[dim_x] = x;
-  world.pc.pos[dim_y] = y;
-  world.pc.symbol = '@';
-
-  world.cur_map->cmap[y][x] = &world.pc;
-  world.pc.next_turn = 0;
+  if (prefetch.busy) {
+    if (!prefetch.done) {
+      return;
+    }
+    prefetch_finish();
+  }
 
-  heap_insert(&world.cur_map->turn, &world.pc);
+  if (prefetch.last_map != m) {
+    prefetch.last_map = m;
+    prefetch.turns_on_map = 0;
+  }
+  linger = ++prefetch.turns_on_map >= PREFETCH_LINGER;
+
+  /* North, south, west and east: the gate, the direction to the     *
+   * neighbor, and where the PC steps onto the neighbor through it.  */
+  gate[0][dim_x] = m->n;         gate[0][dim_y] = 0;
+  gate[1][dim_x] = m->s;         gate[1][dim_y] = MAP_Y - 1;
+  gate[2][dim_x] = 0;            gate[2][dim_y] = m->w;
+  gate[3][dim_x] = MAP_X - 1;    gate[3][dim_y] = m->e;
+  step[0][dim_x] = 0;            step[0][dim_y] = -1;
+  step[1][dim_x] = 0;            step[1][dim_y] = 1;
+  step[2][dim_x] = -1;           step[2][dim_y] = 0;
+  step[3][dim_x] = 1;            step[3][dim_y] = 0;
+  arrive[0][dim_x] = m->n;       arrive[0][dim_y] = MAP_Y - 2;
+  arrive[1][dim_x] = m->s;       arrive[1][dim_y] = 1;
+  arrive[2][dim_x] = MAP_X - 2;  arrive[2][dim_y] = m->w;
+  arrive[3][dim_x] = 1;          arrive[3][dim_y] = m->e;
+
+  for (i = 0; i < 4; i++) {
+    if (gate[i][dim_x] < 0 || gate[i][dim_y] < 0) {
+      continue;
+    }
+    idx[dim_x] = world.cur_idx[dim_x] + step[i][dim_x];
+    idx[dim_y] = world.cur_idx[dim_y] + step[i][dim_y];
+    if (map_cache_contains(idx)) {
+      continue;
+    }
+    dx = abs(world.pc.pos[dim_x] - gate[i][dim_x]);
+    dy = abs(world.pc.pos[dim_y] - gate[i][dim_y]);
+    if (linger || (dx > dy ? dx : dy) <= PREFETCH_DISTANCE) {
+      prefetch_start(idx, arrive[i][dim_x], arrive[i][dim_y]);
+      return;
+    }
+  }
 }
 
-void place_pc()
+/* Called before building the map at idx on the game thread; if that *
+ * is the map in flight, wait for it instead of building it twice.   */
+static void prefetch_wait(pair_t idx)
 {
-  character *c;
-
-  if (world.pc.pos[dim_x] == 1) {
-    world.pc.pos[dim_x] = MAP_X - 2;
-  } else if (world.pc.pos[dim_x] == MAP_X - 2) {
-    world.pc.pos[dim_x] = 1;
-  } else if (world.pc.pos[dim_y] == 1) {
-    world.pc.pos[dim_y] = MAP_Y - 2;
-  } else if (world.pc.pos[dim_y] == MAP_Y - 2) {
-    world.pc.pos[dim_y] = 1;
-  }
-
-  world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = &world.pc;
-
-  if ((c = (character *) heap_peek_min(&world.cur_map->turn))) {
-    world.pc.next_turn = c->next_turn;
-  } else {
-    world.pc.next_turn = 0;
+  if (prefetch.busy &&
+      prefetch.idx[dim_x] == idx[dim_x] &&
+      prefetch.idx[dim_y] == idx[dim_y]) {
+    prefetch_finish();
   }
 }
 
@@ -1351,75 +743,24 @@ void place_pc()
 // cur_map.
 int new_map(int teleport)
 {
-  int d, p;
-  int e, w, n, s;
-  int x, y;
-  
-  if (world.world[world.cur_idx[dim_y]][world.cur_idx[dim_x]]) {
-    world.cur_map = world.world[world.cur_idx[dim_y]][world.cur_idx[dim_x]];
+  std::vector<npc *> trainers;
+  int generated;
+  map_t *m;
+
+  /* Building a map uses the distance maps as scratch space, and a map *
+   * may reuse the address of one that pathfind() last saw.            */
+  world.dist_map = NULL;
+  world.want_map = NULL;
+  prefetch_wait(world.cur_idx);
+
+  if ((m = map_cache_get(world.cur_idx))) {
+    world.cur_map = m;
     place_pc();
 
     return 0;
   }
 
-  world.cur_map                                             =
-    world.world[world.cur_idx[dim_y]][world.cur_idx[dim_x]] =
-    (map_t *) malloc(sizeof (*world.cur_map));
-
-  smooth_height(world.cur_map);
-  
-  if (!world.cur_idx[dim_y]) {
-    n = -1;
-  } else if (world.world[world.cur_idx[dim_y] - 1][world.cur_idx[dim_x]]) {
-    n = world.world[world.cur_idx[dim_y] - 1][world.cur_idx[dim_x]]->s;
-  } else {
-    n = 3 + rand() % (MAP_X - 6);
-  }
-  if (world.cur_idx[dim_y] == WORLD_SIZE - 1) {
-    s = -1;
-  } else if (world.world[world.cur_idx[dim_y] + 1][world.cur_idx[dim_x]]) {
-    s = world.world[world.cur_idx[dim_y] + 1][world.cur_idx[dim_x]]->n;
-  } else  {
-    s = 3 + rand() % (MAP_X - 6);
-  }
-  if (!world.cur_idx[dim_x]) {
-    w = -1;
-  } else if (world.world[world.cur_idx[dim_y]][world.cur_idx[dim_x] - 1]) {
-    w = world.world[world.cur_idx[dim_y]][world.cur_idx[dim_x] - 1]->e;
-  } else {
-    w = 3 + rand() % (MAP_Y - 6);
-  }
-  if (world.cur_idx[dim_x] == WORLD_SIZE - 1) {
-    e = -1;
-  } else if (world.world[world.cur_idx[dim_y]][world.cur_idx[dim_x] + 1]) {
-    e = world.world[world.cur_idx[dim_y]][world.cur_idx[dim_x] + 1]->w;
-  } else {
-    e = 3 + rand() % (MAP_Y - 6);
-  }
-  
-  map_terrain(world.cur_map, n, s, e, w);
-     
-  place_boulders(world.cur_map);
-  place_trees(world.cur_map);
-  build_paths(world.cur_map);
-  d = (abs(world.cur_idx[dim_x] - (WORLD_SIZE / 2)) +
-       abs(world.cur_idx[dim_y] - (WORLD_SIZE / 2)));
-  p = d > 200 ? 5 : (50 - ((45 * d) / 200));
-  //  printf("d=%d, p=%d\n", d, p);
-  if ((rand() % 100) < p || !d) {
-    place_pokemart(world.cur_map);
-  }
-  if ((rand() % 100) < p || !d) {
-    place_center(world.cur_map);
-  }
-
-  for (y = 0; y < MAP_Y; y++) {
-    for (x = 0; x < MAP_X; x++) {
-      world.cur_map->cmap[y][x] = NULL;
-    }
-  }
-
-  heap_init(&world.cur_map->turn, cmp_char_turns, delete_character);
+  generated = build_map(world.cur_idx, &world.cur_map, trainers);
 
   if ((world.cur_idx[dim_x] == WORLD_SIZE / 2) &&
       (world.cur_idx[dim_y] == WORLD_SIZE / 2)) {
@@ -1429,21 +770,33 @@ int new_map(int teleport)
   }
 
   if (teleport) {
+    /* Only land where rivals can reach from the roads, which join every *
+     * gate.  Where the PC arrived needn't even be open ground.          */
+    world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = NULL;
+    do {
+      world.pc.pos[dim_x] = rand_range(1, MAP_X - 2);
+      world.pc.pos[dim_y] = rand_range(1, MAP_Y - 2);
+    } while (world.cur_map->map[world.pc.pos[dim_y]]
+                               [world.pc.pos[dim_x]] != ter_path);
+    pathfind(world.cur_map);
     do {
-      world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = NULL;
       world.pc.pos[dim_x] = rand_range(1, MAP_X - 2);
       world.pc.pos[dim_y] = rand_range(1, MAP_Y - 2);
     } while (world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] ||
              (move_cost[char_pc][world.cur_map->map[world.pc.pos[dim_y]]
                                                    [world.pc.pos[dim_x]]] ==
               INT_MAX)                                                      ||
-             world.rival_dist[world.pc.pos[dim_y]][world.pc.pos[dim_x]] < 0);
+             pathfind_dist(char_rival)[world.pc.pos[dim_y]]
+                                      [world.pc.pos[dim_x]] == INT_MAX);
     world.cur_map->cmap[world.pc.pos[dim_y]][world.pc.pos[dim_x]] = &world.pc;
   }
 
+  populate_map(world.cur_map, generated, world.pc.pos,
+               world.pc.pokemonTeam.size(), &world.dist, trainers);
+  world.dist_map = NULL;
+  map_cache_insert(world.cur_map);
+
   pathfind(world.cur_map);
-  
-  place_characters();
 
   return 0;
 }
@@ -1511,32 +864,27 @@ void init_world()
 
 void delete_world()
 {
-  int x, y;
-
-  //Only correct because current game never leaves the initial map
-  //Need to iterate over all maps in 1.05+
-  heap_delete(&world.cur_map->turn);
-
-  for (y = 0; y < WORLD_SIZE; y++) {
-    for (x = 0; x < WORLD_SIZE; x++) {
-      if (world.world[y][x]) {
-        free(world.world[y][x]);
-        world.world[y][x] = NULL;
-      }
-    }
+  if (prefetch.busy) {
+    prefetch.worker.join();
+    prefetch.busy = 0;
+    map_delete(prefetch.m);
   }
+
+  map_cache_clear();
+  route_clear();
 }
 
 void print_hiker_dist()
 {
+  const int (*dist)[MAP_X] = pathfind_dist(char_hiker);
   int x, y;
 
   for (y = 0; y < MAP_Y; y++) {
     for (x = 0; x < MAP_X; x++) {
-      if (world.hiker_dist[y][x] == INT_MAX) {
+      if (dist[y][x] == INT_MAX) {
         printf("   ");
       } else {
-        printf(" %5d", world.hiker_dist[y][x]);
+        printf(" %5d", dist[y][x]);
       }
     }
     printf("\n");
@@ -1545,14 +893,15 @@ void print_hiker_dist()
 
 void print_rival_dist()
 {
+  const int (*dist)[MAP_X] = pathfind_dist(char_rival);
   int x, y;
 
   for (y = 0; y < MAP_Y; y++) {
     for (x = 0; x < MAP_X; x++) {
-      if (world.rival_dist[y][x] == INT_MAX || world.rival_dist[y][x] < 0) {
+      if (dist[y][x] == INT_MAX || dist[y][x] < 0) {
         printf("   ");
       } else {
-        printf(" %02d", world.rival_dist[y][x] % 100);
+        printf(" %02d", dist[y][x] % 100);
       }
     }
     printf("\n");
@@ -1604,13 +953,21 @@ void game_loop()
     c->pos[dim_y] = d[dim_y];
     c->pos[dim_x] = d[dim_x];
 
+    if (is_pc) {
+      prefetch_update();
+    }
+
     heap_insert(&world.cur_map->turn, c);
   }
 }
 
 void usage(char *s)
 {
-  fprintf(stderr, "Usage: %s [-s|--seed <seed>]\n", s);
+  fprintf(stderr, "Usage: %s [-s|--seed <seed>] [-c|--cache <KB>] "
+          "[-w|--world <file>]\n"
+          "       [-t|--terrain <diffuse|voronoi>] [-d|--dist-cache <KB>]\n"
+          "       [-p|--passes <smoothing passes>]\n",
+          s);
 
   exit(1);
 }
@@ -1621,11 +978,20 @@ int main(int argc, char *argv[])
   uint32_t seed;
   int long_arg;
   int do_seed;
+  int terrain;
+  uint32_t passes;
+  uint32_t cache_kb;
+  uint32_t dist_kb;
+  const char *world_path;
+  map_cache_stats_t stats;
   //  char c;
   //  int x, y;
   int i;
 
   do_seed = 1;
+  cache_kb = MAP_CACHE_KB;
+  dist_kb = DIST_CACHE_KB;
+  world_path = NULL;
   
  // std::string base = getenv("HOME") + "/.poke327/pokedex/pokedex/data/csv/";
   
@@ -1704,6 +1070,48 @@ int main(int argc, char *argv[])
           }
           do_seed = 0;
           break;
+        case 'c':
+          if ((!long_arg && argv[i][2]) ||
+              (long_arg && strcmp(argv[i], "-cache")) ||
+              argc < ++i + 1 /* No more arguments */ ||
+              !sscanf(argv[i], "%u", &cache_kb) /* Not an integer */) {
+            usage(argv[0]);
+          }
+          break;
+        case 'd':
+          if ((!long_arg && argv[i][2]) ||
+              (long_arg && strcmp(argv[i], "-dist-cache")) ||
+              argc < ++i + 1 /* No more arguments */ ||
+              !sscanf(argv[i], "%u", &dist_kb) /* Not an integer */) {
+            usage(argv[0]);
+          }
+          break;
+        case 'w':
+          if ((!long_arg && argv[i][2]) ||
+              (long_arg && strcmp(argv[i], "-world")) ||
+              argc < ++i + 1 /* No more arguments */) {
+            usage(argv[0]);
+          }
+          world_path = argv[i];
+          break;
+        case 't':
+          if ((!long_arg && argv[i][2]) ||
+              (long_arg && strcmp(argv[i], "-terrain")) ||
+              argc < ++i + 1 /* No more arguments */ ||
+              (terrain = terrain_mode_parse(argv[i])) < 0) {
+            usage(argv[0]);
+          }
+          mapgen_set_terrain_mode((terrain_mode_t) terrain);
+          break;
+        case 'p':
+          if ((!long_arg && argv[i][2]) ||
+              (long_arg && strcmp(argv[i], "-passes")) ||
+              argc < ++i + 1 /* No more arguments */ ||
+              !sscanf(argv[i], "%u", &passes) || !passes) {
+            usage(argv[0]);
+          }
+          mapgen_set_smooth_passes(passes);
+          break;
         default:
           usage(argv[0]);
         }
@@ -1722,6 +1130,14 @@ int main(int argc, char *argv[])
 
   printf("Using seed: %u\n", seed);
   srand(seed);
+  world.seed = seed;
+  /* Maps come from the file's seed, terrain mode and smoothing; seed *
+   * still drives everything else.                                      */
+  if (world_path && world_file_open(world_path)) {
+    return 1;
+  }
+  map_cache_init(cache_kb);
+  dist_cache_init(dist_kb);
 
   io_init_terminal();
   init_world();
@@ -1790,10 +1206,24 @@ int main(int argc, char *argv[])
   give_pc_pokemon();
   
   game_loop();
-  
+
+  stats = *map_cache_stats();
   delete_world();
+  world_file_close();
 
   io_reset_terminal();
+
+  printf("Map cache: %u visited, %u hot (%zu KB), %u cold (%zu KB); "
+         "%lu hits, %lu cold faults, %lu misses, "
+         "%lu demoted, %lu evicted\n",
+         stats.visited_maps, stats.hot_maps, stats.hot_bytes / 1024,
+         stats.cold_maps, stats.cold_bytes / 1024,
+         stats.hits, stats.cold_faults, stats.misses,
+         stats.demotions, stats.evictions);
+  printf("Distance cache: %lu hits, %lu misses\n",
+         dist_cache_stats()->hits, dist_cache_stats()->misses);
+  printf("Routes: %u maps costed, %lu nodes expanded\n",
+         route_stats()->maps_costed, route_stats()->nodes_expanded);
   
   return 0;
 }
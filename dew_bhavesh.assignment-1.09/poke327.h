@@ -18,6 +18,10 @@
 /* Returns random integer in [min, max]. */
 # define rand_range(min, max) ((rand() % (((max) + 1) - (min))) + (min))
 
+/* Draws from the private stream in *seed if one is given, otherwise from *
+ * the global rand() stream.  Worker threads must always pass a seed.     */
+# define pokemon_rand(seed) ((seed) ? rand_r(seed) : rand())
+
 # define UNUSED(f) ((void) f)
 
 #define MAP_X              80
@@ -29,6 +33,12 @@
 #define WORLD_SIZE         401
 #define MIN_TRAINERS       7   
 #define ADD_TRAINER_PROB   50
+#define HEIGHT_SMOOTH_PASSES 2    /* Default; see mapgen_set_smooth_passes() */
+#define PREFETCH_DISTANCE  5    /* Build a neighbor when this close to its gate */
+#define PREFETCH_LINGER    20   /* ...or after this many PC turns on one map    */
+#define MAP_CACHE_KB       8192 /* Default memory budget for visited maps       */
+#define DIST_CACHE_KB      64   /* Default cap on each map's cached distances  */
+#define TRAVEL_STEP_US     5000 /* Pause between steps of auto-travel          */
 
 #define mappair(pair) (m->map[pair[dim_y]][pair[dim_x]])
 #define mapxy(x, y) (m->map[y][x])
@@ -86,6 +96,7 @@ class npc : public character {
   movement_type_t mtype;
   int defeated;
   pair_t dir;
+  unsigned int team_seed; /* Rebuilds the same team from scratch */
 };
 
 class pc : public character {
@@ -107,29 +118,199 @@ extern const char *char_type_name[num_character_types];
 
 extern int32_t move_cost[num_character_types][num_terrain_types];
 
+/* Terrain, packed two cells to a byte.  m->map[y][x] reads and writes *
+ * like the terrain_type_t array it replaces.                           */
+class packed_terrain {
+ public:
+  class cell {
+   public:
+    cell(uint8_t *b, int shift) : b(b), shift(shift) {}
+    operator terrain_type_t() const
+    {
+      return (terrain_type_t) ((*b >> shift) & 0xf);
+    }
+    cell &operator=(terrain_type_t t)
+    {
+      *b = (*b & ~(0xf << shift)) | (t << shift);
+      return *this;
+    }
+    cell &operator=(const cell &c) { return *this = (terrain_type_t) c; }
+   private:
+    uint8_t *b;
+    int shift;
+  };
+  class row {
+   public:
+    row(uint8_t *r) : r(r) {}
+    cell operator[](int x) const { return cell(r + (x >> 1), (x & 1) << 2); }
+   private:
+    uint8_t *r;
+  };
+
+  row operator[](int y) { return row(cells[y]); }
+
+  uint8_t cells[MAP_Y][(MAP_X + 1) / 2];
+};
+
+/* Fewer than a couple dozen cells are ever occupied, so occupancy is a   *
+ * bitset over the map plus a small array of the characters on it, in     *
+ * cell order.  A character's slot in the array is the number of occupied *
+ * cells before its own.  m->cmap[y][x] reads and writes like the         *
+ * character * array it replaces.  Maps are malloc()ed, not constructed,  *
+ * so reset() stands in for a constructor and release() for a destructor. */
+class occupancy {
+ public:
+  class cell {
+   public:
+    cell(occupancy *o, int i) : o(o), i(i) {}
+    operator character *() const { return o->get(i); }
+    character *operator->() const { return o->get(i); }
+    cell &operator=(character *c)
+    {
+      o->set(i, c);
+      return *this;
+    }
+    cell &operator=(const cell &c) { return *this = (character *) c; }
+   private:
+    occupancy *o;
+    int i;
+  };
+  class row {
+   public:
+    row(occupancy *o, int base) : o(o), base(base) {}
+    cell operator[](int x) const { return cell(o, base + x); }
+   private:
+    occupancy *o;
+    int base;
+  };
+
+  row operator[](int y) { return row(this, y * MAP_X); }
+
+  void reset();
+  void release();
+  /* The characters on the map, in cell order */
+  uint32_t size() const { return num; }
+  uint32_t capacity() const { return cap; }
+  character *at(uint32_t k) const { return chars[k]; }
+
+ private:
+  uint64_t bits[(MAP_X * MAP_Y + 63) / 64];
+  character **chars;
+  uint16_t num, cap;
+
+  uint32_t rank(int i) const
+  {
+    uint32_t r;
+    int w;
+
+    for (r = w = 0; w < i >> 6; w++) {
+      r += __builtin_popcountll(bits[w]);
+    }
+
+    return r + __builtin_popcountll(bits[w] & ((1ULL << (i & 63)) - 1));
+  }
+  character *get(int i) const
+  {
+    return (bits[i >> 6] >> (i & 63)) & 1 ? chars[rank(i)] : NULL;
+  }
+  void set(int i, character *c);
+};
+
+/* Bodies of water, for swimmers.  A swimmer can be on water or on a    *
+ * path beside it, and those cells are joined into bodies, 8-connected,  *
+ * numbered from 1; every other cell is 0.  shore has a bit for each     *
+ * cell next to water.  Both are made with the terrain, when a map is    *
+ * built or thawed, and cover only the map's interior.                   */
+typedef struct water_labels {
+  uint16_t body[MAP_Y][MAP_X];
+  uint8_t shore[MAP_Y][(MAP_X + 7) / 8];
+} water_labels_t;
+
+#define water_shore(w, x, y) (((w)->shore[y][(x) >> 3] >> ((x) & 7)) & 1)
+
 typedef struct map {
-  terrain_type_t map[MAP_Y][MAP_X];
-  uint8_t height[MAP_Y][MAP_X];
-  character *cmap[MAP_Y][MAP_X];
+  packed_terrain map;
+  occupancy cmap;
+  water_labels_t water;
   heap_t turn;
   int32_t num_trainers;
   int8_t n, s, e, w;
+  pair_t idx;
+  /* The PC's team size when the map was first built, which its trainers' *
+   * team sizes scale with; kept so that thawing rebuilds the same teams. */
+  uint32_t pc_team_size;
+  /* Owned by the map cache */
+  uint32_t cache_bytes;
+  struct map *lru_prev, *lru_next;
+  /* Owned by pathfind() */
+  struct dist_entry *dist_cache;
+  uint32_t dist_bytes;
 } map_t;
 
+/* The NPC types that move by distance maps to the PC */
+#define num_pathing_types 3
+
+/* Distance maps to one cell for the pathing NPC types.  Types whose   *
+ * move_cost rows are the same share one map, which is only made once; *
+ * of[] is the map each pathing type moves by, and NULL for the rest.  *
+ * For world.dist, each map can also have a flow field, made by        *
+ * pathfind_flow() when first wanted after the maps change.            */
+typedef struct dist_maps {
+  int map[num_pathing_types][MAP_Y][MAP_X];
+  const int (*of[num_character_types])[MAP_X];
+  uint8_t flow[num_pathing_types][MAP_Y][MAP_X];
+  uint8_t flow_made[num_pathing_types];
+  uint8_t flow_base;
+} dist_maps_t;
+
+/* Notes that the distance maps in world.dist should be from the PC's *
+ * cell on m.  They're only made when pathfind_dist() or               *
+ * pathfind_flow() asks for them, so turns on which no pathing NPC     *
+ * moves cost nothing.                                                 */
 void pathfind(map_t *m);
+const int (*pathfind_dist(character_type_t ctype))[MAP_X];
+void pathfind_from(map_t *m, pair_t from, dist_maps_t *dist);
+/* The flow field for ctype's map in world.dist: the index in all_dirs *
+ * of each cell's neighbor nearest the PC, or FLOW_NONE, so an NPC's   *
+ * step is a lookup instead of a search.  Ties are broken at random,   *
+ * once each time the maps change.  ctype must be a pathing type.      */
+#define FLOW_NONE 0xff
+const uint8_t (*pathfind_flow(character_type_t ctype))[MAP_X];
+
+/* pathfind() keeps the distance maps it makes on each map, up to cap_kb *
+ * per map, least recently used out first, and reuses them when the PC   *
+ * is back on the same cell.  Terrain never changes once a map is made,  *
+ * so they stay good for as long as the map does; map_delete() frees    *
+ * them.  m->dist_bytes is what they take, which the map cache counts    *
+ * against its budget.  A cap too small for one set of maps turns this   *
+ * off.                                                                  */
+typedef struct dist_cache_stats {
+  uint64_t hits;
+  uint64_t misses;
+} dist_cache_stats_t;
+
+void dist_cache_init(size_t cap_kb);
+void dist_cache_free(map_t *m);
+const dist_cache_stats_t *dist_cache_stats();
 extern void (*move_func[num_movement_types])(character *, pair_t);
 
 typedef struct world {
-  map_t *world[WORLD_SIZE][WORLD_SIZE];
   pair_t cur_idx;
   map_t *cur_map;
   /* Please distance maps in world, not map, since *
-   * we only need one pair at any given time.      */
-  int hiker_dist[MAP_Y][MAP_X];
-  int rival_dist[MAP_Y][MAP_X];
+   * we only need one set at any given time.       */
+  dist_maps_t dist;
+  /* Where the distance maps were last made from, for pathfind().  Only *
+   * it may set dist_map; anything else that writes them clears it.     */
+  map_t *dist_map;
+  pair_t dist_from;
+  /* Where pathfind() was last asked for them from; NULL if nowhere */
+  map_t *want_map;
+  pair_t want_from;
   class pc pc;
   int quit;
   int add_trainer_prob;
+  uint32_t seed;
   Pokemon pokemon[1093];
   Moves moves[845];
   PokemonMoves pokeMoves[528239];
@@ -141,8 +322,9 @@ typedef struct world {
   PokemonTypes pokeTypes[1676];
 } world_t;
 
-/* Even unallocated, a WORLD_SIZE x WORLD_SIZE array of pointers is a very *
- * large thing to put on the stack.  To avoid that, world is a global.     */
+/* With the Pokemon tables, world is a very large thing to put on the *
+ * stack.  To avoid that, world is a global.  Maps are found through  *
+ * the map cache (mapcache.h), not world.                             */
 extern world_t world;
 
 extern pair_t all_dirs[8];
@@ -161,5 +343,9 @@ typedef struct path {
 } path_t;
 
 int new_map(int teleport);
+void map_delete(map_t *m);
+int map_distance(pair_t idx);
+void generate_npc_teams(std::vector<npc *> &trainers, int distance,
+                        uint32_t pc_team_size);
 
 #endif
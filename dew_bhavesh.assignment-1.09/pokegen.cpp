@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "poke327.h"
+#include "mapgen.h"
+#include "worldfile.h"
+
+/* Pregenerates a rectangle of the world, every map in it built in      *
+ * parallel, into a world file that the game can open with -w.  Nothing *
+ * here touches ncurses or the Pokemon tables; teams are rebuilt from   *
+ * their seeds when the game loads a map.                               */
+
+/* Maps are generated a chunk at a time, then written out in order */
+#define GEN_CHUNK 4096
+
+world_t world;
+
+static double now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void generate_chunk(pair_t origin, int16_t width, uint32_t first,
+                           std::vector<map_record_t *> &records,
+                           uint32_t num_threads)
+{
+  std::vector<std::thread> workers;
+  std::atomic<uint32_t> next(0);
+  uint32_t i;
+
+  auto work = [&]() {
+    dist_maps_t dist;
+    std::vector<npc *> trainers;
+    pair_t idx;
+    map_t *m;
+    uint32_t k;
+
+    while ((k = next++) < records.size()) {
+      idx[dim_x] = origin[dim_x] + (first + k) % width;
+      idx[dim_y] = origin[dim_y] + (first + k) / width;
+      m = (map_t *) malloc(sizeof (*m));
+      trainers.clear();
+      generate_map(m, idx, &dist, trainers);
+      records[k] = map_freeze(m);
+      map_delete(m);
+    }
+  };
+
+  for (i = 0; i < num_threads; i++) {
+    workers.push_back(std::thread(work));
+  }
+  for (i = 0; i < num_threads; i++) {
+    workers[i].join();
+  }
+}
+
+static int write_world(const char *path, pair_t origin, pair_t size,
+                       uint32_t num_threads)
+{
+  std::vector<map_record_t *> records;
+  std::vector<uint64_t> offsets;
+  world_file_header_t header;
+  uint64_t off, total_bytes;
+  uint32_t i, first, num_maps;
+  double start, elapsed;
+  size_t len;
+  FILE *f;
+
+  if (!(f = fopen(path, "w"))) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  num_maps = size[dim_x] * size[dim_y];
+  memset(&header, 0, sizeof (header));
+  memcpy(header.magic, WORLD_FILE_MAGIC, sizeof (header.magic));
+  header.version = WORLD_FILE_VERSION;
+  header.seed = world.seed;
+  header.terrain = mapgen_terrain_mode();
+  header.smooth = mapgen_smooth_passes();
+  header.origin[dim_x] = origin[dim_x];
+  header.origin[dim_y] = origin[dim_y];
+  header.size[dim_x] = size[dim_x];
+  header.size[dim_y] = size[dim_y];
+
+  /* The index is written last, once the offsets are known */
+  offsets.resize(num_maps);
+  off = sizeof (header) + num_maps * sizeof (offsets[0]);
+  fseek(f, off, SEEK_SET);
+
+  start = now();
+  total_bytes = 0;
+  for (first = 0; first < num_maps; first += GEN_CHUNK) {
+    records.assign(num_maps - first < GEN_CHUNK ?
+                   num_maps - first : GEN_CHUNK, NULL);
+    generate_chunk(origin, size[dim_x], first, records, num_threads);
+
+    for (i = 0; i < records.size(); i++) {
+      len = map_record_size(records[i]);
+      offsets[first + i] = off;
+      fwrite(records[i], len, 1, f);
+      total_bytes += len;
+      off += len;
+      /* Keep records aligned */
+      for (; off & 7; off++) {
+        fputc(0, f);
+      }
+      free(records[i]);
+    }
+  }
+  elapsed = now() - start;
+
+  fseek(f, 0, SEEK_SET);
+  fwrite(&header, sizeof (header), 1, f);
+  fwrite(offsets.data(), sizeof (offsets[0]), num_maps, f);
+  if (fclose(f)) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  printf("Wrote %u maps (%dx%d at %d,%d) to %s: %llu bytes of records\n",
+         num_maps, size[dim_x], size[dim_y],
+         origin[dim_x] - WORLD_SIZE / 2, origin[dim_y] - WORLD_SIZE / 2,
+         path, (unsigned long long) total_bytes);
+  printf("%.3f s on %u threads: %.0f maps/sec, %.0f maps/sec/core\n",
+         elapsed, num_threads, num_maps / elapsed,
+         num_maps / elapsed / num_threads);
+
+  return 0;
+}
+
+void usage(char *s)
+{
+  fprintf(stderr, "Usage: %s [-s|--seed <seed>] [-j|--jobs <threads>]\n"
+          "       [-r|--rect <x> <y> <width> <height>] [-o|--output <file>]\n"
+          "       [-t|--terrain <diffuse|voronoi>]\n"
+          "       [-p|--passes <smoothing passes>]\n"
+          "x and y are the map coordinates of the rectangle's northwest\n"
+          "corner, as shown in the game.  The default is the whole world.\n",
+          s);
+
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  struct timeval tv;
+  uint32_t seed;
+  uint32_t num_threads;
+  int long_arg;
+  int do_seed;
+  int x, y, w, h;
+  int terrain;
+  uint32_t passes;
+  pair_t origin, size;
+  const char *path;
+  int i;
+
+  do_seed = 1;
+  num_threads = std::thread::hardware_concurrency();
+  x = y = -(WORLD_SIZE / 2);
+  w = h = WORLD_SIZE;
+  path = "world.pkw";
+
+  for (i = 1, long_arg = 0; i < argc; i++, long_arg = 0) {
+    if (argv[i][0] != '-') {
+      usage(argv[0]);
+    }
+    if (argv[i][1] == '-') {
+      argv[i]++;
+      long_arg = 1;
+    }
+    switch (argv[i][1]) {
+    case 's':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-seed")) ||
+          argc < ++i + 1 ||
+          !sscanf(argv[i], "%u", &seed)) {
+        usage(argv[0]);
+      }
+      do_seed = 0;
+      break;
+    case 'j':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-jobs")) ||
+          argc < ++i + 1 ||
+          !sscanf(argv[i], "%u", &num_threads) || !num_threads) {
+        usage(argv[0]);
+      }
+      break;
+    case 'r':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-rect")) ||
+          argc < i + 5 ||
+          !sscanf(argv[++i], "%d", &x) || !sscanf(argv[++i], "%d", &y) ||
+          !sscanf(argv[++i], "%d", &w) || !sscanf(argv[++i], "%d", &h)) {
+        usage(argv[0]);
+      }
+      break;
+    case 'o':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-output")) ||
+          argc < ++i + 1) {
+        usage(argv[0]);
+      }
+      path = argv[i];
+      break;
+    case 't':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-terrain")) ||
+          argc < ++i + 1 ||
+          (terrain = terrain_mode_parse(argv[i])) < 0) {
+        usage(argv[0]);
+      }
+      mapgen_set_terrain_mode((terrain_mode_t) terrain);
+      break;
+    case 'p':
+      if ((!long_arg && argv[i][2]) ||
+          (long_arg && strcmp(argv[i], "-passes")) ||
+          argc < ++i + 1 ||
+          !sscanf(argv[i], "%u", &passes) || !passes) {
+        usage(argv[0]);
+      }
+      mapgen_set_smooth_passes(passes);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  x += WORLD_SIZE / 2;
+  y += WORLD_SIZE / 2;
+  if (x < 0 || y < 0 || w <= 0 || h <= 0 ||
+      x + w > WORLD_SIZE || y + h > WORLD_SIZE) {
+    fprintf(stderr, "Rectangle is not within the world\n");
+    return 1;
+  }
+  origin[dim_x] = x;
+  origin[dim_y] = y;
+  size[dim_x] = w;
+  size[dim_y] = h;
+
+  if (do_seed) {
+    gettimeofday(&tv, NULL);
+    seed = (tv.tv_usec ^ (tv.tv_sec << 20)) & 0xffffffff;
+  }
+  printf("Using seed: %u, %s terrain, %u smoothing passes\n", seed,
+         terrain_mode_name[mapgen_terrain_mode()], mapgen_smooth_passes());
+  world.seed = seed;
+
+  return write_world(path, origin, size, num_threads) ? 1 : 0;
+}
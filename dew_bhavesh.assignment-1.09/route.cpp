@@ -0,0 +1,374 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "poke327.h"
+#include "mapgen.h"
+#include "mapcache.h"
+#include "worldfile.h"
+#include "route.h"
+
+/* What a map costs to cross: from the port of gate a out through gate *
+ * b, the step onto the gate included, or INT_MAX if there's no way.   *
+ * at[] is where each gate is along its edge, or -1 if there isn't one. */
+typedef struct gate_costs {
+  int32_t cost[num_gates][num_gates];
+  int8_t at[num_gates];
+} gate_costs_t;
+
+/* A node of the search: the port of gate id % num_gates on the map *
+ * with key id / num_gates.                                         */
+typedef struct route_node {
+  heap_node_t *hn;
+  uint32_t id;
+  uint32_t from;   /* The node it's reached from, or ROUTE_START */
+  int32_t cost;
+  int32_t bound;   /* cost, plus a bound on the rest of the way  */
+} route_node_t;
+
+#define ROUTE_START UINT32_MAX
+
+static const gate_t opposite[num_gates] = { gate_s, gate_n, gate_e, gate_w };
+
+static std::unordered_map<uint32_t, gate_costs_t> costs;
+static route_stats_t stats;
+
+/* The distance maps to the ports of the map at field_idx, which  *
+ * route_plan() starts from and route_step() walks by.            */
+static int field[num_gates][MAP_Y][MAP_X];
+static pair_t field_idx = { -1, -1 };
+static pair_t field_port[num_gates], field_gate[num_gates];
+
+static uint32_t map_key(pair_t idx)
+{
+  return idx[dim_y] * WORLD_SIZE + idx[dim_x];
+}
+
+/* The map through gate g of the map at idx, or 0 if off the world */
+static int next_map(pair_t idx, gate_t g, pair_t next)
+{
+  next[dim_x] = idx[dim_x] + (g == gate_e) - (g == gate_w);
+  next[dim_y] = idx[dim_y] + (g == gate_s) - (g == gate_n);
+
+  return (next[dim_x] >= 0 && next[dim_x] < WORLD_SIZE &&
+          next[dim_y] >= 0 && next[dim_y] < WORLD_SIZE);
+}
+
+/* The cells of gate g, at at along its edge, and of its port */
+static void gate_cells(gate_t g, int8_t at, pair_t port, pair_t gate)
+{
+  if (at < 0) {
+    port[dim_x] = port[dim_y] = gate[dim_x] = gate[dim_y] = -1;
+    return;
+  }
+
+  switch (g) {
+  case gate_n:
+    gate[dim_x] = at;         gate[dim_y] = 0;
+    port[dim_x] = at;         port[dim_y] = 1;
+    break;
+  case gate_s:
+    gate[dim_x] = at;         gate[dim_y] = MAP_Y - 1;
+    port[dim_x] = at;         port[dim_y] = MAP_Y - 2;
+    break;
+  case gate_w:
+    gate[dim_x] = 0;          gate[dim_y] = at;
+    port[dim_x] = 1;          port[dim_y] = at;
+    break;
+  default:
+    gate[dim_x] = MAP_X - 1;  gate[dim_y] = at;
+    port[dim_x] = MAP_X - 2;  port[dim_y] = at;
+    break;
+  }
+}
+
+static void map_gate_cells(map_t *m, pair_t port[num_gates],
+                           pair_t gate[num_gates])
+{
+  const int8_t at[num_gates] = { m->n, m->s, m->w, m->e };
+  uint32_t g;
+
+  for (g = 0; g < num_gates; g++) {
+    gate_cells((gate_t) g, at[g], port[g], gate[g]);
+  }
+}
+
+static void port_fields(map_t *m)
+{
+  if (m->idx[dim_x] == field_idx[dim_x] && m->idx[dim_y] == field_idx[dim_y]) {
+    return;
+  }
+
+  map_gate_cells(m, field_port, field_gate);
+  pathfind_ports(m, field_port, field);
+  field_idx[dim_x] = m->idx[dim_x];
+  field_idx[dim_y] = m->idx[dim_y];
+}
+
+static void cost_gates(map_t *m, gate_costs_t *gc)
+{
+  static int dist[num_gates][MAP_Y][MAP_X];
+  pair_t port[num_gates], gate[num_gates];
+  uint32_t a, b;
+  int d;
+
+  map_gate_cells(m, port, gate);
+  pathfind_ports(m, port, dist);
+
+  gc->at[gate_n] = m->n;
+  gc->at[gate_s] = m->s;
+  gc->at[gate_w] = m->w;
+  gc->at[gate_e] = m->e;
+  for (a = 0; a < num_gates; a++) {
+    for (b = 0; b < num_gates; b++) {
+      gc->cost[a][b] = INT_MAX;
+      if (a == b || port[a][dim_x] < 0 || port[b][dim_x] < 0 ||
+          (d = dist[b][port[a][dim_y]][port[a][dim_x]]) == INT_MAX) {
+        continue;
+      }
+      gc->cost[a][b] = d + move_cost[char_pc][m->map[gate[b][dim_y]]
+                                                    [gate[b][dim_x]]];
+    }
+  }
+}
+
+/* Costs the map at idx the first time it's asked for.  A map that isn't *
+ * hot in the map cache is read from the world file, if it's there, or    *
+ * has its terrain made over, which is all that matters, rather than      *
+ * disturbing the cache.                                                  */
+static const gate_costs_t *gate_costs(pair_t idx)
+{
+  std::unordered_map<uint32_t, gate_costs_t>::iterator i;
+  std::vector<npc *> trainers;
+  const map_record_t *r;
+  gate_costs_t *gc;
+  map_t *m;
+
+  if ((i = costs.find(map_key(idx))) != costs.end()) {
+    return &i->second;
+  }
+
+  gc = &costs[map_key(idx)];
+  if ((m = map_cache_peek(idx))) {
+    cost_gates(m, gc);
+  } else if ((r = world_file_record(idx))) {
+    m = map_thaw(r, trainers);
+    cost_gates(m, gc);
+    map_delete(m);
+  } else {
+    m = (map_t *) malloc(sizeof (*m));
+    generate_map_terrain(m, idx);
+    cost_gates(m, gc);
+    map_delete(m);
+  }
+  stats.maps_costed++;
+
+  return gc;
+}
+
+static int32_t least_pc_cost()
+{
+  static int32_t least;
+  uint32_t t;
+
+  if (!least) {
+    for (least = INT_MAX, t = 0; t < num_terrain_types; t++) {
+      least = std::min(least, move_cost[char_pc][t]);
+    }
+  }
+
+  return least;
+}
+
+/* Cells to cross from p, on map m of a row or column of maps size     *
+ * cells across, to get onto map t.  Maps in between are crossed from  *
+ * port to gate, size - 2 cells.                                       */
+static int32_t cells_across(int16_t m, int16_t p, int16_t t, int16_t size)
+{
+  if (t > m) {
+    return size - 1 - p + (t - m - 1) * (size - 2);
+  }
+  if (t < m) {
+    return p + (m - t - 1) * (size - 2);
+  }
+
+  return 0;
+}
+
+/* Never more than the cost from pos on the map at idx to the map at to, *
+ * since a step crosses at most one column and one row, and costs at    *
+ * least the least of the PC's move costs.                              */
+static int32_t route_bound(pair_t idx, pair_t pos, pair_t to)
+{
+  return least_pc_cost() *
+    std::max(cells_across(idx[dim_x], pos[dim_x], to[dim_x], MAP_X),
+             cells_across(idx[dim_y], pos[dim_y], to[dim_y], MAP_Y));
+}
+
+static int32_t route_node_cmp(const void *key, const void *with)
+{
+  return ((route_node_t *) key)->bound - ((route_node_t *) with)->bound;
+}
+
+typedef std::unordered_map<uint32_t, route_node_t> route_nodes_t;
+
+/* Offers the node through gate g, at at along its edge, of the map at *
+ * idx, reached from node from at cost.                                */
+static void route_reach(heap_t *h, route_nodes_t &nodes, pair_t idx,
+                        gate_t g, int8_t at, int32_t cost, uint32_t from,
+                        pair_t to)
+{
+  std::pair<route_nodes_t::iterator, bool> r;
+  pair_t next, port, gate;
+  route_node_t *n;
+  uint32_t id;
+
+  if (!next_map(idx, g, next)) {
+    return;
+  }
+  id = map_key(next) * num_gates + opposite[g];
+
+  r = nodes.insert(std::make_pair(id, route_node_t()));
+  n = &r.first->second;
+  if (r.second) {
+    n->hn = NULL;
+    n->id = id;
+    n->cost = INT_MAX;
+  }
+  if (cost >= n->cost) {
+    return;
+  }
+
+  gate_cells(opposite[g], at, port, gate);
+  n->cost = cost;
+  n->bound = cost + route_bound(next, port, to);
+  n->from = from;
+  if (n->hn) {
+    heap_decrease_key_no_replace(h, n->hn);
+  } else {
+    n->hn = heap_insert(h, n);
+  }
+}
+
+int32_t route_plan(map_t *m, pair_t from, pair_t to,
+                   std::vector<route_leg_t> &legs)
+{
+  route_nodes_t nodes;
+  const gate_costs_t *gc;
+  route_node_t *n;
+  route_leg_t leg;
+  pair_t idx;
+  heap_t h;
+  uint32_t a, b;
+  int d;
+
+  legs.clear();
+  if (m->idx[dim_x] == to[dim_x] && m->idx[dim_y] == to[dim_y]) {
+    return 0;
+  }
+
+  port_fields(m);
+  heap_init(&h, route_node_cmp, NULL);
+  for (b = 0; b < num_gates; b++) {
+    if (field_port[b][dim_x] < 0 ||
+        (d = field[b][from[dim_y]][from[dim_x]]) == INT_MAX) {
+      continue;
+    }
+    route_reach(&h, nodes, m->idx, (gate_t) b,
+                b < gate_w ? field_gate[b][dim_x] : field_gate[b][dim_y],
+                d + move_cost[char_pc][m->map[field_gate[b][dim_y]]
+                                             [field_gate[b][dim_x]]],
+                ROUTE_START, to);
+  }
+
+  while ((n = (route_node_t *) heap_remove_min(&h))) {
+    n->hn = NULL;
+    stats.nodes_expanded++;
+
+    idx[dim_x] = n->id / num_gates % WORLD_SIZE;
+    idx[dim_y] = n->id / num_gates / WORLD_SIZE;
+    if (idx[dim_x] == to[dim_x] && idx[dim_y] == to[dim_y]) {
+      break;
+    }
+
+    gc = gate_costs(idx);
+    a = n->id % num_gates;
+    for (b = 0; b < num_gates; b++) {
+      if (gc->cost[a][b] != INT_MAX) {
+        route_reach(&h, nodes, idx, (gate_t) b, gc->at[b],
+                    n->cost + gc->cost[a][b], n->id, to);
+      }
+    }
+  }
+  heap_delete(&h);
+
+  if (!n) {
+    return -1;
+  }
+
+  /* Back from the port reached, each node names the gate it came through */
+  for (d = n->cost; ; n = &nodes[n->from]) {
+    leg.exit = opposite[n->id % num_gates];
+    idx[dim_x] = n->id / num_gates % WORLD_SIZE;
+    idx[dim_y] = n->id / num_gates / WORLD_SIZE;
+    next_map(idx, opposite[leg.exit], leg.idx);
+    legs.push_back(leg);
+    if (n->from == ROUTE_START) {
+      break;
+    }
+  }
+  std::reverse(legs.begin(), legs.end());
+
+  return d;
+}
+
+int route_step(map_t *m, pair_t from, gate_t exit, pair_t dest)
+{
+  int32_t c, best;
+  uint32_t i;
+  int x, y;
+
+  port_fields(m);
+  if (field_port[exit][dim_x] < 0 ||
+      field[exit][from[dim_y]][from[dim_x]] == INT_MAX) {
+    return -1;
+  }
+
+  if (from[dim_x] == field_port[exit][dim_x] &&
+      from[dim_y] == field_port[exit][dim_y]) {
+    dest[dim_x] = field_gate[exit][dim_x];
+    dest[dim_y] = field_gate[exit][dim_y];
+    return 0;
+  }
+
+  /* The neighbor that the distance to the port is made through */
+  for (best = INT_MAX, i = 0; i < 8; i++) {
+    x = from[dim_x] + all_dirs[i][dim_x];
+    y = from[dim_y] + all_dirs[i][dim_y];
+    if (field[exit][y][x] == INT_MAX) {
+      continue;
+    }
+    if ((c = field[exit][y][x] + move_cost[char_pc][m->map[y][x]]) < best) {
+      best = c;
+      dest[dim_x] = x;
+      dest[dim_y] = y;
+    }
+  }
+
+  return 0;
+}
+
+const route_stats_t *route_stats()
+{
+  return &stats;
+}
+
+void route_clear()
+{
+  std::unordered_map<uint32_t, gate_costs_t>().swap(costs);
+  field_idx[dim_x] = field_idx[dim_y] = -1;
+}
@@ -0,0 +1,63 @@
+#ifndef ROUTE_H
+# define ROUTE_H
+
+# include <stdint.h>
+
+# include <vector>
+
+# include "poke327.h"
+
+/* Routes between maps are planned over a graph of the world's gates,  *
+ * not its cells.  A node is the cell just inside one of a map's gates, *
+ * its port, which is where the PC arrives through that gate.  Its     *
+ * edges lead out through each of the map's other gates to the port    *
+ * across, weighted by what the PC pays to walk there.  Those weights   *
+ * are worked out once per map, from the terrain alone, which never     *
+ * changes, and kept until the world is deleted, so a map is searched   *
+ * cell by cell only the first time a route crosses it.  Maps not yet   *
+ * visited are read from the world file, or have their terrain          *
+ * generated, just to cost them.  The search is A* under a bound from   *
+ * how many columns and rows are left to cross.                         */
+
+typedef enum gate {
+  gate_n,
+  gate_s,
+  gate_w,
+  gate_e,
+  num_gates
+} gate_t;
+
+/* One map along a route: leave the map at idx through its exit gate */
+typedef struct route_leg {
+  pair_t idx;
+  gate_t exit;
+} route_leg_t;
+
+typedef struct route_stats {
+  uint32_t maps_costed;     /* Maps whose gate costs have been worked out */
+  uint64_t nodes_expanded;  /* Over every route planned                   */
+} route_stats_t;
+
+/* The cheapest way for the PC from cell from on m to the map at to, as *
+ * the maps to leave and the gate to leave each by, into legs.  Returns *
+ * its cost, 0 if m is already at to, or -1 if there's no way there.    *
+ * Trainers aren't in the way of a route, since they move.  Nothing     *
+ * here is tied to the PC but its move costs, so it can as well plan    *
+ * long moves for anything that moves like the PC.                      */
+int32_t route_plan(map_t *m, pair_t from, pair_t to,
+                   std::vector<route_leg_t> &legs);
+/* The next cell from from on m toward leaving m through exit, into    *
+ * dest: the gate cell itself from its port, which is straight across  *
+ * from it, so the PC arrives on the port of the next map.  Returns -1, *
+ * with dest left alone, if there's no way from from to exit.           */
+int route_step(map_t *m, pair_t from, gate_t exit, pair_t dest);
+const route_stats_t *route_stats();
+/* Forgets every map's gate costs, along with the rest of the world */
+void route_clear();
+
+/* Distance maps for the PC to each port over m's interior, into dist; *
+ * a gate that m doesn't have has port[] of -1 and a map all INT_MAX.   */
+void pathfind_ports(map_t *m, const pair_t port[num_gates],
+                    int dist[num_gates][MAP_Y][MAP_X]);
+
+#endif
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "worldfile.h"
+
+static const uint8_t *base;
+static size_t length;
+static const world_file_header_t *header;
+static const uint64_t *offsets;
+
+int world_file_open(const char *path)
+{
+  struct stat sb;
+  void *p;
+  int fd;
+
+  if ((fd = open(path, O_RDONLY)) < 0) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  if (fstat(fd, &sb) < 0 ||
+      (p = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0)) ==
+      MAP_FAILED) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  /* The mapping outlives the descriptor */
+  close(fd);
+
+  base = (const uint8_t *) p;
+  length = sb.st_size;
+  header = (const world_file_header_t *) base;
+  offsets = (const uint64_t *) (header + 1);
+
+  if (length < sizeof (*header) ||
+      memcmp(header->magic, WORLD_FILE_MAGIC, sizeof (header->magic)) ||
+      header->version != WORLD_FILE_VERSION ||
+      header->terrain >= num_terrain_modes || !header->smooth ||
+      header->size[dim_x] < 0 || header->size[dim_y] < 0 ||
+      (length - sizeof (*header)) / sizeof (*offsets) <
+      (size_t) header->size[dim_x] * header->size[dim_y]) {
+    fprintf(stderr, "%s: Not a world file\n", path);
+    world_file_close();
+    return -1;
+  }
+
+  world.seed = header->seed;
+  mapgen_set_terrain_mode((terrain_mode_t) header->terrain);
+  mapgen_set_smooth_passes(header->smooth);
+
+  return 0;
+}
+
+const map_record_t *world_file_record(pair_t idx)
+{
+  const map_record_t *r;
+  int16_t x, y;
+  uint64_t off;
+
+  if (!base) {
+    return NULL;
+  }
+
+  x = idx[dim_x] - header->origin[dim_x];
+  y = idx[dim_y] - header->origin[dim_y];
+  if (x < 0 || x >= header->size[dim_x] ||
+      y < 0 || y >= header->size[dim_y] ||
+      !(off = offsets[y * header->size[dim_x] + x]) ||
+      off + sizeof (*r) > length) {
+    return NULL;
+  }
+
+  r = (const map_record_t *) (base + off);
+  if (off + map_record_size(r) > length ||
+      r->idx[dim_x] != idx[dim_x] || r->idx[dim_y] != idx[dim_y]) {
+    return NULL;
+  }
+
+  return r;
+}
+
+void world_file_close()
+{
+  if (base) {
+    munmap((void *) base, length);
+  }
+  base = NULL;
+  length = 0;
+  header = NULL;
+  offsets = NULL;
+}
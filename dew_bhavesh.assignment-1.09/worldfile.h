@@ -0,0 +1,36 @@
+#ifndef WORLDFILE_H
+# define WORLDFILE_H
+
+# include <stdint.h>
+
+# include "poke327.h"
+# include "mapgen.h"
+
+/* A pregenerated world, as written by pokegen: this header, then a      *
+ * size[dim_y] x size[dim_x] index of file offsets, in row-major order,  *
+ * then each map's record (see mapgen.h), 8-byte aligned.  An offset of  *
+ * 0 means the map isn't in the file.  The file is only valid for the    *
+ * build that wrote it, since records are raw structs.                   */
+# define WORLD_FILE_MAGIC   "POKEWRLD"
+# define WORLD_FILE_VERSION 3
+
+typedef struct world_file_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t seed;
+  pair_t origin;    /* World index of the first map in the file */
+  pair_t size;      /* Maps across and down                      */
+  uint32_t terrain; /* terrain_mode_t the maps were made with    */
+  uint32_t smooth;  /* Smoothing passes the maps were made with */
+} world_file_header_t;
+
+/* Maps the world file at path and adopts its seed as world.seed, and   *
+ * its terrain mode and smoothing, so maps outside its rectangle are    *
+ * generated as pokegen would have made them.  Returns 0 on success, or *
+ * -1 with a message on stderr.                                        */
+int world_file_open(const char *path);
+/* The record for the map at idx, or NULL if it isn't in the file */
+const map_record_t *world_file_record(pair_t idx);
+void world_file_close();
+
+#endif